@@ -0,0 +1,357 @@
+#pragma once
+
+#include <new>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+// Interface for anything that hands out raw memory (DynamicArray, etc)
+// Pass one of these to a container to control where its storage comes from
+class IAllocator
+{
+public:
+	virtual ~IAllocator() = default;
+
+	virtual void* allocate(size_t size, size_t alignment) = 0;
+	virtual void deallocate(void* memory, size_t size, size_t alignment) = 0;
+
+	// Tries to grow or shrink an allocation without moving it, returns false if it can't (the caller then reallocates and copies)
+	virtual bool resize_in_place(void*, size_t, size_t) { return false; }
+
+	// Allocator a copy of a container using this one should use, allocators that can't serve a second container hand out another one
+	virtual IAllocator* select_for_copy() { return this; }
+};
+
+// Goes straight to global ::operator new/::operator delete
+class HeapAllocator : public IAllocator
+{
+public:
+	void* allocate(size_t size, size_t alignment) override
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			return ::operator new(size, std::align_val_t(alignment));
+
+		return ::operator new(size);
+	}
+
+	void deallocate(void* memory, size_t size, size_t alignment) override
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			::operator delete(memory, size, std::align_val_t(alignment));
+		else
+			::operator delete(memory, size);
+	}
+
+	// Shared instance, used by default when a container isn't given an allocator
+	static HeapAllocator& get()
+	{
+		static HeapAllocator s_Instance;
+		return s_Instance;
+	}
+};
+
+// Bump allocator over a single fixed-size buffer
+// deallocate() does nothing, everything is released at once with reset() (ie. at the end of a frame)
+// Destructors of objects living in the arena are not called on reset(), that's up to the owner
+class ArenaAllocator : public IAllocator
+{
+public:
+	ArenaAllocator(size_t capacity)
+		: m_Capacity(capacity)
+	{
+		m_Buffer = static_cast<uint8_t*>(::operator new(m_Capacity));
+	}
+	~ArenaAllocator()
+	{
+		::operator delete(m_Buffer, m_Capacity);
+	}
+
+	ArenaAllocator(const ArenaAllocator&) = delete;
+	ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+	void* allocate(size_t size, size_t alignment) override
+	{
+		uintptr_t base = reinterpret_cast<uintptr_t>(m_Buffer);
+		uintptr_t aligned = (base + m_Offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		size_t offset = aligned - base;
+
+		ASSERT(offset + size <= m_Capacity && "arena out of memory");
+
+		m_Offset = offset + size;
+		return m_Buffer + offset;
+	}
+
+	void deallocate(void*, size_t, size_t) override {}
+
+	// The most recent allocation can be resized by just moving the bump offset
+	bool resize_in_place(void* memory, size_t oldSize, size_t newSize) override
+	{
+		size_t offset = static_cast<uint8_t*>(memory) - m_Buffer;
+		if (offset + oldSize != m_Offset || offset + newSize > m_Capacity)
+			return false;
+
+		m_Offset = offset + newSize;
+		return true;
+	}
+
+	// Releases everything allocated from the arena
+	void reset() { m_Offset = 0; }
+
+	size_t used() const { return m_Offset; }
+	size_t capacity() const { return m_Capacity; }
+private:
+	uint8_t* m_Buffer = nullptr;
+	size_t m_Offset = 0;
+	size_t m_Capacity = 0;
+};
+
+// Hands out fixed-size blocks from a preallocated slab, freed blocks are kept on an intrusive free list
+// Both allocate() and deallocate() are O(1), requests bigger than the block size are rejected
+// Not thread safe, use ThreadSafePoolAllocator when blocks are allocated or freed from more than one thread
+class PoolAllocator : public IAllocator
+{
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next = nullptr;
+	};
+public:
+	PoolAllocator(size_t blockSize, size_t blockCount, size_t blockAlignment = alignof(std::max_align_t))
+		: m_BlockAlignment(blockAlignment), m_BlockCount(blockCount)
+	{
+		// Blocks must be able to hold the free list link and keep every block aligned
+		blockSize = std::max(blockSize, sizeof(FreeBlock));
+		m_BlockSize = (blockSize + blockAlignment - 1) & ~(blockAlignment - 1);
+
+		m_Buffer = static_cast<uint8_t*>(::operator new(m_BlockSize * m_BlockCount, std::align_val_t(m_BlockAlignment)));
+		for (size_t i = m_BlockCount; i > 0; i--)
+			push_free(m_Buffer + (i - 1) * m_BlockSize);
+	}
+	~PoolAllocator()
+	{
+		::operator delete(m_Buffer, m_BlockSize * m_BlockCount, std::align_val_t(m_BlockAlignment));
+	}
+
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	void* allocate(size_t size, size_t alignment) override
+	{
+		ASSERT(size <= m_BlockSize && alignment <= m_BlockAlignment && "pool block too small for allocation");
+		ASSERT(m_FreeList && "pool out of blocks");
+
+		FreeBlock* block = m_FreeList;
+		m_FreeList = block->next;
+		m_FreeCount--;
+
+		return block;
+	}
+
+	void deallocate(void* memory, size_t, size_t) override
+	{
+		if (memory)
+			push_free(memory);
+	}
+
+	size_t block_size() const { return m_BlockSize; }
+	size_t free_count() const { return m_FreeCount; }
+private:
+	void push_free(void* memory)
+	{
+		FreeBlock* block = new(memory) FreeBlock{ m_FreeList };
+		m_FreeList = block;
+		m_FreeCount++;
+	}
+private:
+	uint8_t* m_Buffer = nullptr;
+	FreeBlock* m_FreeList = nullptr;
+	size_t m_BlockSize = 0;
+	size_t m_BlockAlignment = 0;
+	size_t m_BlockCount = 0;
+	size_t m_FreeCount = 0;
+};
+
+// PoolAllocator behind a mutex, for blocks that are allocated and freed on different threads
+// ie. the blocks of a shared_ptr from allocate_shared(), those go back to the pool on whichever thread drops the last reference
+class ThreadSafePoolAllocator : public IAllocator
+{
+public:
+	ThreadSafePoolAllocator(size_t blockSize, size_t blockCount, size_t blockAlignment = alignof(std::max_align_t))
+		: m_Pool(blockSize, blockCount, blockAlignment)
+	{
+	}
+
+	void* allocate(size_t size, size_t alignment) override
+	{
+		std::lock_guard lock(m_Mutex);
+		return m_Pool.allocate(size, alignment);
+	}
+
+	void deallocate(void* memory, size_t size, size_t alignment) override
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Pool.deallocate(memory, size, alignment);
+	}
+
+	size_t block_size() const { return m_Pool.block_size(); }
+	size_t free_count()
+	{
+		std::lock_guard lock(m_Mutex);
+		return m_Pool.free_count();
+	}
+private:
+	PoolAllocator m_Pool;
+	std::mutex m_Mutex;
+};
+
+// Reserves a large range of address space up front and commits pages only as the allocation grows
+// Meant to back a single huge container (ie. DynamicArray<T>(2, &virtualAllocator)), growth then never copies or moves elements
+// and only the pages actually in use count towards memory usage
+// Only one allocation can be live at a time, it always starts at the beginning of the reserved range
+class VirtualAllocator : public IAllocator
+{
+public:
+	// reserveSize is the most the allocation will ever be able to grow to
+	// With hugePages (Linux only) the range is marked for transparent huge pages, which cuts down on TLB misses for big arrays
+	VirtualAllocator(size_t reserveSize, bool hugePages = false)
+	{
+		m_PageSize = hugePages ? HugePageSize : system_page_size();
+		m_Reserved = round_to_page(reserveSize);
+
+#ifdef _WIN32
+		m_Base = static_cast<uint8_t*>(VirtualAlloc(nullptr, m_Reserved, MEM_RESERVE, PAGE_NOACCESS));
+#else
+		// Huge pages only back 2MB aligned ranges, so reserve one page extra, then trim off what's in front of the first aligned address and past the end
+		size_t extra = hugePages ? HugePageSize : 0;
+		void* base = mmap(nullptr, m_Reserved + extra, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		m_Base = base == MAP_FAILED ? nullptr : static_cast<uint8_t*>(base);
+		if (m_Base && hugePages)
+		{
+			uint8_t* aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(m_Base) + HugePageSize - 1) & ~uintptr_t(HugePageSize - 1));
+			size_t front = aligned - m_Base;
+			if (front)
+				munmap(m_Base, front);
+			if (extra - front)
+				munmap(aligned + m_Reserved, extra - front);
+			m_Base = aligned;
+
+	#ifdef MADV_HUGEPAGE
+			madvise(m_Base, m_Reserved, MADV_HUGEPAGE);
+	#endif
+		}
+#endif
+		ASSERT(m_Base && "failed to reserve address space");
+	}
+	~VirtualAllocator()
+	{
+#ifdef _WIN32
+		VirtualFree(m_Base, 0, MEM_RELEASE);
+#else
+		munmap(m_Base, m_Reserved);
+#endif
+	}
+
+	VirtualAllocator(const VirtualAllocator&) = delete;
+	VirtualAllocator& operator=(const VirtualAllocator&) = delete;
+
+	void* allocate(size_t size, size_t alignment) override
+	{
+		ASSERT(!m_InUse && size <= m_Reserved && "virtual allocator reservation exhausted");
+		ASSERT(alignment <= m_PageSize && "virtual allocator memory is only page aligned");
+
+		m_InUse = true;
+		commit(size);
+		return m_Base;
+	}
+
+	void deallocate(void* memory, size_t, size_t) override
+	{
+		if (memory != m_Base)
+			return;
+
+		commit(0);
+		m_InUse = false;
+	}
+
+	bool resize_in_place(void* memory, [[maybe_unused]] size_t oldSize, size_t newSize) override
+	{
+		// Pages are committed based on newSize alone, the old size doesn't matter
+		if (memory != m_Base || newSize > m_Reserved)
+			return false;
+
+		commit(newSize);
+		return true;
+	}
+
+	// There's only one allocation, so copies of a container backed by this allocator go to the heap
+	IAllocator* select_for_copy() override { return &HeapAllocator::get(); }
+
+	size_t committed() const { return m_Committed; }
+	size_t reserved() const { return m_Reserved; }
+private:
+	static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+	// Commits or decommits pages so exactly round_to_page(size) bytes are usable
+	void commit(size_t size)
+	{
+		size_t target = round_to_page(size);
+		if (target > m_Committed)
+		{
+#ifdef _WIN32
+			void* result = VirtualAlloc(m_Base + m_Committed, target - m_Committed, MEM_COMMIT, PAGE_READWRITE);
+			ASSERT(result && "failed to commit memory");
+#else
+			int result = mprotect(m_Base + m_Committed, target - m_Committed, PROT_READ | PROT_WRITE);
+			ASSERT(result == 0 && "failed to commit memory");
+#endif
+		}
+		else if (target < m_Committed)
+		{
+			// Hand the pages back to the OS so they stop counting towards RSS
+#ifdef _WIN32
+			VirtualFree(m_Base + target, m_Committed - target, MEM_DECOMMIT);
+#else
+			madvise(m_Base + target, m_Committed - target, MADV_DONTNEED);
+			mprotect(m_Base + target, m_Committed - target, PROT_NONE);
+#endif
+		}
+
+		m_Committed = target;
+	}
+
+	size_t round_to_page(size_t size) const
+	{
+		return (size + m_PageSize - 1) / m_PageSize * m_PageSize;
+	}
+
+	static size_t system_page_size()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+private:
+	uint8_t* m_Base = nullptr;
+	size_t m_Reserved = 0;
+	size_t m_Committed = 0;
+	size_t m_PageSize = 0;
+	bool m_InUse = false;
+};
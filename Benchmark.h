@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Bitset.h"
+#include "Command.h"
+#include "DynamicArray.h"
+#include "Function.h"
+#include "Ptrs.h"
+#include "Serializer.h"
+
+// Micro benchmarks run from the command line (./app --bench <name>, or --bench all), each prints its own results
+// Numbers are wall clock on whatever machine runs them, they're meant for comparing the variants within one run
+
+// Seconds fn() takes to run
+template<typename F>
+static double bench_seconds(F&& fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	fn();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Stores value somewhere the optimizer has to assume is read, so the work producing it can't be skipped
+template<typename T>
+static void bench_keep(const T& value)
+{
+	static const void* volatile sink;
+	sink = &value;
+	(void)sink;
+}
+
+// Threads hammering claim_first_unset()/reset() on one AtomicBitset, with every thread starting at word 0
+// (worst case, all of them fight over the same cache line) and with a start hint per thread
+static void bench_bitset()
+{
+	constexpr size_t OpsPerThread = 2'000'000;
+	size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+	printf("AtomicBitset<1024> claim_first_unset + reset, %zu ops per thread\n", OpsPerThread);
+	for (size_t threads = 1; threads <= maxThreads * 2; threads *= 2)
+	{
+		for (bool spread : { false, true })
+		{
+			AtomicBitset<1024> bits;
+			double seconds = bench_seconds([&]()
+			{
+				std::vector<std::thread> workers;
+				for (size_t t = 0; t < threads; t++)
+				{
+					workers.emplace_back([&bits, t, spread]()
+					{
+						size_t hint = spread ? t * 64 : 0;
+						for (size_t i = 0; i < OpsPerThread; i++)
+						{
+							size_t index = bits.claim_first_unset(hint);
+							bits.reset(index);
+						}
+					});
+				}
+
+				for (std::thread& worker : workers)
+					worker.join();
+			});
+
+			printf("  %2zu threads, %-11s %8.1f M ops/s\n", threads, spread ? "spread hint" : "same hint", threads * OpsPerThread / seconds / 1e6);
+		}
+	}
+}
+
+// Short lists (1 to 8 ints) built, summed and thrown away, then 100k of them kept around and walked,
+// to compare DynamicArray<int, 8> (inline storage) against DynamicArray<int> (always on the heap)
+template<size_t N>
+static void bench_short_lists_with(const char* label)
+{
+	constexpr size_t Lists = 1'000'000;
+	constexpr size_t KeptLists = 100'000;
+
+	uint64_t sum = 0;
+	double temporary = bench_seconds([&]()
+	{
+		for (size_t i = 0; i < Lists; i++)
+		{
+			DynamicArray<int, N> list;
+			size_t length = i % 8 + 1;
+			for (size_t j = 0; j < length; j++)
+				list.add(int(i + j));
+			for (int value : list)
+				sum += value;
+		}
+	});
+
+	DynamicArray<DynamicArray<int, N>> kept(KeptLists);
+	double build = bench_seconds([&]()
+	{
+		for (size_t i = 0; i < KeptLists; i++)
+		{
+			DynamicArray<int, N>& list = kept.emplace();
+			for (size_t j = 0; j < i % 8 + 1; j++)
+				list.add(int(i + j));
+		}
+	});
+	double walk = bench_seconds([&]()
+	{
+		for (int pass = 0; pass < 10; pass++)
+			for (const DynamicArray<int, N>& list : kept)
+				for (int value : list)
+					sum += value;
+	});
+	bench_keep(sum);
+
+	printf("  %-22s build+sum+free %6.1f ns/list, build kept %6.1f ns/list, walk kept %5.2f ns/list\n",
+		label, temporary / Lists * 1e9, build / KeptLists * 1e9, walk / (KeptLists * 10) * 1e9);
+}
+
+static void bench_short_lists()
+{
+	printf("DynamicArray short lists (1-8 ints)\n");
+	bench_short_lists_with<0>("DynamicArray<int>");
+	bench_short_lists_with<8>("DynamicArray<int, 8>");
+}
+
+// InplaceFunction against Function and std::function: making one from a lambda with a few captures (and destroying it),
+// then calling one that's already made
+static void bench_functions()
+{
+	constexpr size_t Count = 10'000'000;
+
+	uint64_t sum = 0;
+	uint64_t a = 1, b = 2, c = 3;
+	auto lambda = [&sum, a, b, c](int x) { sum += x + a + b + c; };
+
+	double makeFunction = bench_seconds([&]()
+	{
+		for (size_t i = 0; i < Count; i++)
+		{
+			Function f = lambda;
+			f(int(i));
+		}
+	});
+	double makeStd = bench_seconds([&]()
+	{
+		for (size_t i = 0; i < Count; i++)
+		{
+			std::function<void(int)> f = lambda;
+			f(int(i));
+		}
+	});
+	double makeInplace = bench_seconds([&]()
+	{
+		for (size_t i = 0; i < Count; i++)
+		{
+			InplaceFunction<void(int)> f = lambda;
+			f(int(i));
+		}
+	});
+
+	Function function = lambda;
+	std::function<void(int)> stdFunction = lambda;
+	InplaceFunction<void(int)> inplace = lambda;
+
+	double callFunction = bench_seconds([&]() { for (size_t i = 0; i < Count; i++) function(int(i)); });
+	double callStd = bench_seconds([&]() { for (size_t i = 0; i < Count; i++) stdFunction(int(i)); });
+	double callInplace = bench_seconds([&]() { for (size_t i = 0; i < Count; i++) inplace(int(i)); });
+	bench_keep(sum);
+
+	printf("Callables holding a lambda with 32 bytes of captures, %zu each\n", Count);
+	printf("  %-22s make+call+destroy %6.2f ns, call %5.2f ns\n", "Function", makeFunction / Count * 1e9, callFunction / Count * 1e9);
+	printf("  %-22s make+call+destroy %6.2f ns, call %5.2f ns\n", "std::function", makeStd / Count * 1e9, callStd / Count * 1e9);
+	printf("  %-22s make+call+destroy %6.2f ns, call %5.2f ns\n", "InplaceFunction", makeInplace / Count * 1e9, callInplace / Count * 1e9);
+}
+
+struct BenchParticle
+{
+	float position[3];
+	float velocity[3];
+};
+struct BenchIntrusiveParticle : ref_counted<BenchIntrusiveParticle>, BenchParticle {};
+struct BenchPooledParticle : allocated_ref_counted<BenchPooledParticle>, BenchParticle {};
+
+// Times count rounds of making an object with make and dropping it again
+template<typename Make>
+static double bench_churn(size_t count, Make&& make)
+{
+	return bench_seconds([&]()
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			auto object = make();
+			object->position[0] = float(i);
+			bench_keep(object->position[0]);
+		}
+	});
+}
+
+// Creating and dropping 10M small objects through each kind of shared pointer, from the heap and from a pool
+static void bench_pointer_churn()
+{
+	constexpr size_t Count = 10'000'000;
+
+	PoolAllocator sharedPool(shared_block_size<BenchParticle>, 16, alignof(std::max_align_t));
+	ThreadSafePoolAllocator lockedSharedPool(shared_block_size<BenchParticle>, 16, alignof(std::max_align_t));
+	PoolAllocator intrusivePool(sizeof(BenchPooledParticle), 16, alignof(BenchPooledParticle));
+
+	double heapShared = bench_churn(Count, []() { return make_shared<BenchParticle>(); });
+	double poolShared = bench_churn(Count, [&]() { return allocate_shared<BenchParticle>(lockedSharedPool); });
+	double heapLocal = bench_churn(Count, []() { return make_local_shared<BenchParticle>(); });
+	double poolLocal = bench_churn(Count, [&]() { return allocate_local_shared<BenchParticle>(sharedPool); });
+	double heapIntrusive = bench_churn(Count, []() { return make_intrusive<BenchIntrusiveParticle>(); });
+	double poolIntrusive = bench_churn(Count, [&]() { return allocate_intrusive<BenchPooledParticle>(intrusivePool); });
+
+	printf("Create + destroy of a 24 byte object, %zu each\n", Count);
+	printf("  %-18s heap %6.2f ns, pool %6.2f ns (ThreadSafePoolAllocator)\n", "shared_ptr", heapShared / Count * 1e9, poolShared / Count * 1e9);
+	printf("  %-18s heap %6.2f ns, pool %6.2f ns\n", "local_shared_ptr", heapLocal / Count * 1e9, poolLocal / Count * 1e9);
+	printf("  %-18s heap %6.2f ns, pool %6.2f ns\n", "intrusive_ptr", heapIntrusive / Count * 1e9, poolIntrusive / Count * 1e9);
+}
+
+static uint64_t s_BenchCommandSum = 0;
+static void bench_command_move(uint32_t entity, float x, float y) { s_BenchCommandSum += entity + uint64_t(x + y); }
+static void bench_command_damage(uint32_t entity, int32_t amount) { s_BenchCommandSum += entity + amount; }
+static void bench_command_scale(double factor) { s_BenchCommandSum += uint64_t(factor); }
+
+// Writes a script of a million numeric commands (three commands interleaved, every argument a number) and runs it with execute_script()
+static void bench_command_script()
+{
+	constexpr size_t Lines = 1'000'000;
+	std::string path = (std::filesystem::temp_directory_path() / "bench_commands.txt").string();
+
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			printf("couldn't write '%s'\n", path.c_str());
+			return;
+		}
+
+		for (size_t i = 0; i < Lines; i++)
+		{
+			switch (i % 3)
+			{
+			case 0: fprintf(file, "move %zu %.3f %.3f\n", i % 10000, i * 0.25, i * -0.5); break;
+			case 1: fprintf(file, "damage %zu %d\n", i % 10000, int(i % 200) - 100); break;
+			case 2: fprintf(file, "scale %.6f\n", 1.0 + i * 1e-6); break;
+			}
+		}
+		fclose(file);
+	}
+
+	CommandHandler handler;
+	handler.listen_for("move", bench_command_move);
+	handler.listen_for("damage", bench_command_damage);
+	handler.listen_for("scale", bench_command_scale);
+	handler.freeze();
+
+	ScriptResult result = handler.execute_script(path);
+	std::filesystem::remove(path);
+	bench_keep(s_BenchCommandSum);
+
+	printf("Script of %zu numeric commands (%zu failed)\n", result.commands, result.errors.size());
+	printf("  %.3fs, %.2f M commands/s\n", result.seconds, result.commands_per_second() / 1e6);
+}
+
+// Saving and loading 512 MiB through a Serializer: as 16 float arrays of 32 MiB (the bulk block path)
+// and as 8M uint64_t written one at a time, with open() against open_write() and open_read()
+// The file is read back right after it's written so loads mostly come from the page cache, not the disk
+static void bench_serializer()
+{
+	constexpr size_t Arrays = 16;
+	constexpr size_t ArrayFloats = 8 * 1024 * 1024;
+	constexpr size_t Values = 8 * 1024 * 1024;
+	constexpr double MiB = 1024.0 * 1024.0;
+	std::string path = (std::filesystem::temp_directory_path() / "bench_serializer.bin").string();
+
+	std::vector<float> data(ArrayFloats);
+	for (size_t i = 0; i < ArrayFloats; i++)
+		data[i] = float(i);
+
+	auto save_arrays = [&](Serializer& serializer) { for (size_t i = 0; i < Arrays; i++) serializer.write(data); serializer.close(); };
+	auto save_values = [&](Serializer& serializer) { for (size_t i = 0; i < Values; i++) serializer.write(uint64_t(i)); serializer.close(); };
+
+	std::vector<float> loaded;
+	uint64_t sum = 0;
+	auto load_arrays = [&](Serializer& serializer) { for (size_t i = 0; i < Arrays; i++) { serializer.read(loaded); sum += loaded.size(); } serializer.close(); };
+	auto load_values = [&](Serializer& serializer) { for (size_t i = 0; i < Values; i++) sum += serializer.read<uint64_t>(); serializer.close(); };
+
+	auto report = [](const char* label, double bytes, double save, double load)
+	{
+		printf("  %-22s save %7.1f MiB/s, load %7.1f MiB/s\n", label, bytes / MiB / save, bytes / MiB / load);
+	};
+
+	printf("Serializer, %zu MiB of float arrays and %zu MiB of single uint64_t values\n", Arrays * ArrayFloats * sizeof(float) >> 20, Values * sizeof(uint64_t) >> 20);
+
+	for (bool buffered : { false, true })
+	{
+		Serializer serializer;
+		double arraySave = bench_seconds([&]() { buffered ? (void)serializer.open_write(path) : serializer.open(path); save_arrays(serializer); });
+		double arrayLoad = bench_seconds([&]() { buffered ? (void)serializer.open_read(path) : serializer.open(path); load_arrays(serializer); });
+		std::filesystem::remove(path);
+
+		double valueSave = bench_seconds([&]() { buffered ? (void)serializer.open_write(path) : serializer.open(path); save_values(serializer); });
+		double valueLoad = bench_seconds([&]() { buffered ? (void)serializer.open_read(path) : serializer.open(path); load_values(serializer); });
+		std::filesystem::remove(path);
+
+		report(buffered ? "open_write/read arrays" : "open() arrays", double(Arrays * ArrayFloats * sizeof(float)), arraySave, arrayLoad);
+		report(buffered ? "open_write/read values" : "open() values", double(Values * sizeof(uint64_t)), valueSave, valueLoad);
+	}
+	bench_keep(sum);
+}
+
+struct Benchmark
+{
+	const char* name;
+	void(*run)();
+};
+
+static constexpr Benchmark Benchmarks[] = {
+	{ "bitset", bench_bitset },
+	{ "short-lists", bench_short_lists },
+	{ "functions", bench_functions },
+	{ "script", bench_command_script },
+	{ "pointers", bench_pointer_churn },
+	{ "serializer", bench_serializer },
+};
+
+// Runs the benchmark called name (or every one for "all"), returns false if there's no such benchmark
+static bool run_benchmark(std::string_view name)
+{
+	bool found = false;
+	for (const Benchmark& benchmark : Benchmarks)
+	{
+		if (name != "all" && name != benchmark.name)
+			continue;
+
+		benchmark.run();
+		found = true;
+	}
+
+	if (!found)
+	{
+		printf("no benchmark called '%.*s', there's:", (int)name.size(), name.data());
+		for (const Benchmark& benchmark : Benchmarks)
+			printf(" %s", benchmark.name);
+		printf(" all\n");
+	}
+	return found;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <bit>
+
 template<size_t N>
 class Bitset;
 
@@ -153,6 +156,110 @@ public:
 	BitsetIterator<NBits> end() const { return BitsetIterator<NBits>(this, NBits); }
 };
 
+// Bitset<N> that can be written to from multiple threads at once
+// Bits are packed into 64-bit words and every modification is a single fetch_or/fetch_and, so concurrent writers never lose each other's bits
+// Can be used as a lock-free slot allocator through claim_first_unset()/reset()
+template<size_t N>
+class AtomicBitset
+{
+private:
+	static constexpr size_t NWords = (N + 63) / 64;
+	static constexpr size_t NBits = NWords * 64; // N rounded up to multiple of 64
+	std::atomic<uint64_t> m_Words[NWords]{};
+public:
+	static constexpr size_t npos = ~size_t(0);
+public:
+	AtomicBitset()
+	{
+		reset_all();
+	}
+
+	AtomicBitset(const AtomicBitset&) = delete;
+	AtomicBitset& operator=(const AtomicBitset&) = delete;
+
+	// Sets a bit to 1, returns the previous value of the bit
+	bool test_and_set(size_t index)
+	{
+		uint64_t mask = bit_mask(index);
+		return m_Words[index / 64].fetch_or(mask, std::memory_order_acq_rel) & mask;
+	}
+
+	// Sets a bit to 0, returns the previous value of the bit
+	bool reset(size_t index)
+	{
+		uint64_t mask = bit_mask(index);
+		return m_Words[index / 64].fetch_and(~mask, std::memory_order_acq_rel) & mask;
+	}
+
+	void set(size_t index, bool value)
+	{
+		if (value)
+			test_and_set(index);
+		else
+			reset(index);
+	}
+
+	bool get(size_t index) const
+	{
+		return m_Words[index / 64].load(std::memory_order_acquire) & bit_mask(index);
+	}
+
+	bool operator[](size_t index) const
+	{
+		return get(index);
+	}
+
+	// Atomically finds a bit that is 0 and sets it to 1, returns its index or npos if every bit is set
+	// Pass a different start_hint per thread (ie. thread index * 64) so threads don't all fight over the first word
+	size_t claim_first_unset(size_t start_hint = 0)
+	{
+		size_t first = (start_hint / 64) % NWords;
+		for (size_t i = 0; i < NWords; i++)
+		{
+			size_t word = (first + i) % NWords;
+			uint64_t bits = m_Words[word].load(std::memory_order_relaxed);
+
+			// Retry within the same word until someone else fills it up
+			while (bits != ~uint64_t(0))
+			{
+				uint64_t mask = uint64_t(1) << std::countr_one(bits);
+				uint64_t previous = m_Words[word].fetch_or(mask, std::memory_order_acq_rel);
+				if (!(previous & mask))
+					return word * 64 + std::countr_zero(mask);
+
+				bits = previous | mask;
+			}
+		}
+
+		return npos;
+	}
+
+	// Not safe to call while other threads are modifying the bitset
+	void reset_all(bool flag = false)
+	{
+		for (size_t i = 0; i < NWords; i++)
+			m_Words[i].store(flag ? ~uint64_t(0) : 0, std::memory_order_relaxed);
+
+		// Padding bits past N are permanently set so claim_first_unset() never hands them out
+		if constexpr (NBits != N)
+			m_Words[NWords - 1].fetch_or(~uint64_t(0) << (N % 64), std::memory_order_relaxed);
+	}
+
+	// Number of bits currently set (a snapshot, may be stale by the time it returns)
+	size_t popcount() const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < NWords; i++)
+			count += std::popcount(m_Words[i].load(std::memory_order_relaxed));
+
+		return count - (NBits - N);
+	}
+
+	constexpr size_t count() const { return N; }
+private:
+	static uint64_t bit_mask(size_t index) { return uint64_t(1) << (index % 64); }
+};
+
 #if 0
 // Same as Bitset<N>, but stores a dynamically-resizing buffer of uint8_t
 // Only grows, with 2x growth every reallocation
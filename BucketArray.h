@@ -0,0 +1,259 @@
+#pragma once
+
+#include "DynamicArray.h"
+
+#include <algorithm>
+#include <bit>
+
+// Unordered container that never moves its elements, pointers stay valid until the element itself is erased
+// Elements live in fixed-size blocks of roughly BlockSize slots (see SlotCount), each block keeps a bitmask of which slots are occupied
+// insert() reuses erased slots (via a list of blocks that have room) and erase() is O(1), also when given just a T*
+// Iteration walks the occupied bits of each block, so it stays close to a contiguous loop as long as blocks are reasonably full
+template<typename T, size_t BlockSize = 64>
+class BucketArray
+{
+private:
+	static_assert(BlockSize > 0, "BlockSize can't be 0");
+
+	// Bytes in front of the slots of a block with the given number of slots
+	static constexpr size_t header_size(size_t slots)
+	{
+		size_t header = (slots + 63) / 64 * sizeof(uint64_t) + sizeof(size_t) + sizeof(void*);
+		return (header + alignof(T) - 1) / alignof(T) * alignof(T);
+	}
+
+	// Blocks take up exactly a power of two bytes and are allocated aligned to it, so the block owning an element can be found by masking its address
+	// That's the smallest power of two BlockSize elements fit in, the header shares it, so a block holds whatever number of slots is left next to the header
+	static constexpr size_t BlockAlignment = std::bit_ceil(std::max(BlockSize * sizeof(T), header_size(1) + sizeof(T)));
+
+	static constexpr size_t slot_count()
+	{
+		size_t slots = BlockAlignment / sizeof(T);
+		while (header_size(slots) + slots * sizeof(T) > BlockAlignment)
+			slots--;
+		return slots;
+	}
+
+	static constexpr size_t SlotCount = slot_count();
+	static constexpr size_t NWords = (SlotCount + 63) / 64;
+
+	struct Block
+	{
+		uint64_t occupied[NWords]{};
+		size_t count = 0;
+		Block* nextFree = nullptr; // next block with at least one free slot
+		alignas(T) uint8_t storage[SlotCount * sizeof(T)];
+
+		T* slots() { return reinterpret_cast<T*>(storage); }
+
+		bool has(size_t slot) const { return occupied[slot / 64] & (uint64_t(1) << (slot % 64)); }
+		void mark(size_t slot) { occupied[slot / 64] |= uint64_t(1) << (slot % 64); }
+		void unmark(size_t slot) { occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64)); }
+
+		size_t first_free() const
+		{
+			for (size_t i = 0; i < NWords; i++)
+			{
+				if (occupied[i] != ~uint64_t(0))
+					return i * 64 + std::countr_one(occupied[i]);
+			}
+			return SlotCount;
+		}
+
+		// First occupied slot at or after start, SlotCount if there is none
+		size_t next_occupied(size_t start) const
+		{
+			for (size_t i = start / 64; i < NWords; i++)
+			{
+				uint64_t bits = occupied[i];
+				if (i == start / 64)
+					bits &= ~uint64_t(0) << (start % 64);
+
+				if (bits)
+					return i * 64 + std::countr_zero(bits);
+			}
+			return SlotCount;
+		}
+	};
+
+	static_assert(sizeof(Block) <= BlockAlignment, "block header doesn't fit");
+public:
+	// Value is T, or const T for ConstIterator
+	template<typename Value>
+	class BasicIterator
+	{
+	public:
+		BasicIterator(Block* const* blocks, size_t blockCount, size_t block, size_t slot)
+			: p_Blocks(blocks), m_BlockCount(blockCount), m_Block(block), m_Slot(slot)
+		{
+			skip_free();
+		}
+
+		BasicIterator& operator++()
+		{
+			m_Slot++;
+			skip_free();
+			return *this;
+		}
+		BasicIterator operator++(int)
+		{
+			BasicIterator it = *this;
+			++(*this);
+			return it;
+		}
+
+		Value* operator->() const
+		{
+			return p_Blocks[m_Block]->slots() + m_Slot;
+		}
+		Value& operator*() const
+		{
+			return p_Blocks[m_Block]->slots()[m_Slot];
+		}
+		bool operator==(const BasicIterator& other) const
+		{
+			return m_Block == other.m_Block && m_Slot == other.m_Slot;
+		}
+		bool operator!=(const BasicIterator& other) const
+		{
+			return !(*this == other);
+		}
+	private:
+		// Moves forward to the next occupied slot (or end)
+		void skip_free()
+		{
+			while (m_Block < m_BlockCount)
+			{
+				m_Slot = p_Blocks[m_Block]->next_occupied(m_Slot);
+				if (m_Slot < SlotCount)
+					return;
+
+				m_Block++;
+				m_Slot = 0;
+			}
+		}
+	private:
+		Block* const* p_Blocks = nullptr;
+		size_t m_BlockCount = 0;
+		size_t m_Block = 0;
+		size_t m_Slot = 0;
+	};
+public:
+	using Iterator = BasicIterator<T>;
+	using ConstIterator = BasicIterator<const T>;
+public:
+	// allocator only ever gets requests for whole blocks, block_bytes() bytes aligned to block_bytes()
+	// (so a PoolAllocator of such blocks works), the table of block pointers always comes from the heap
+	BucketArray(IAllocator* allocator = &HeapAllocator::get())
+		: m_Blocks(2, &HeapAllocator::get()), m_Allocator(allocator)
+	{
+	}
+	~BucketArray()
+	{
+		clear();
+		for (Block* block : m_Blocks)
+		{
+			block->~Block();
+			m_Allocator->deallocate(block, BlockAlignment, BlockAlignment);
+		}
+	}
+
+	// Copying would give every element a new address, which defeats the purpose
+	BucketArray(const BucketArray&) = delete;
+	BucketArray& operator=(const BucketArray&) = delete;
+
+	T& insert(const T& element) { return emplace(element); }
+	T& insert(T&& element) { return emplace(std::move(element)); }
+
+	template<typename... Args>
+	T& emplace(Args&&... args)
+	{
+		if (!m_FreeBlocks)
+			allocate_block();
+
+		Block* block = m_FreeBlocks;
+		size_t slot = block->first_free();
+
+		T* element = new(block->slots() + slot) T(std::forward<Args>(args)...);
+		block->mark(slot);
+		m_Size++;
+
+		if (++block->count == SlotCount)
+		{
+			// Full, stop handing it out
+			m_FreeBlocks = block->nextFree;
+			block->nextFree = nullptr;
+		}
+
+		return *element;
+	}
+
+	// element must point into this container
+	void erase(T* element)
+	{
+		Block* block = block_of(element);
+		size_t slot = element - block->slots();
+
+		element->~T();
+		block->unmark(slot);
+		m_Size--;
+
+		if (block->count-- == SlotCount)
+		{
+			// Was full, so it isn't on the free list yet
+			block->nextFree = m_FreeBlocks;
+			m_FreeBlocks = block;
+		}
+	}
+	void erase(Iterator it)
+	{
+		erase(&*it);
+	}
+
+	// Destroys every element, blocks are kept around for reuse
+	void clear()
+	{
+		m_FreeBlocks = nullptr;
+		for (size_t i = m_Blocks.size(); i > 0; i--)
+		{
+			Block* block = m_Blocks[i - 1];
+			for (size_t slot = block->next_occupied(0); slot < SlotCount; slot = block->next_occupied(slot + 1))
+				block->slots()[slot].~T();
+
+			memset(block->occupied, 0, sizeof(block->occupied));
+			block->count = 0;
+			block->nextFree = m_FreeBlocks;
+			m_FreeBlocks = block;
+		}
+		m_Size = 0;
+	}
+
+	size_t size() const { return m_Size; }
+	size_t capacity() const { return m_Blocks.size() * SlotCount; }
+	// Size and alignment of every allocation made from the allocator
+	static constexpr size_t block_bytes() { return BlockAlignment; }
+
+	Iterator begin() { return Iterator(m_Blocks.data(), m_Blocks.size(), 0, 0); }
+	Iterator end()   { return Iterator(m_Blocks.data(), m_Blocks.size(), m_Blocks.size(), 0); }
+	ConstIterator begin() const { return ConstIterator(m_Blocks.data(), m_Blocks.size(), 0, 0); }
+	ConstIterator end()   const { return ConstIterator(m_Blocks.data(), m_Blocks.size(), m_Blocks.size(), 0); }
+private:
+	void allocate_block()
+	{
+		Block* block = new(m_Allocator->allocate(BlockAlignment, BlockAlignment)) Block();
+		block->nextFree = m_FreeBlocks;
+		m_FreeBlocks = block;
+
+		m_Blocks.add(block);
+	}
+
+	static Block* block_of(T* element)
+	{
+		return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(element) & ~(uintptr_t)(BlockAlignment - 1));
+	}
+private:
+	DynamicArray<Block*> m_Blocks;
+	Block* m_FreeBlocks = nullptr;
+	size_t m_Size = 0;
+	IAllocator* m_Allocator = nullptr;
+};
@@ -1,58 +1,208 @@
 #pragma once
 
+#include <cstdarg>
+#include <cstdio>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <chrono>
+#include <algorithm>
 
-// Erases leading and trailing whitespace from a string
-static void string_trim_whitespace(std::string& string)
+#include "Function.h"
+#include "MappedFile.h"
+#include "Simd.h"
+
+// Most arguments a single command can take, arguments are kept on the stack while parsing
+static constexpr size_t CommandMaxArguments = 16;
+
+// Why a command couldn't be run
+enum class CommandError
 {
-	string.erase(0, string.find_first_not_of(' '));
-	string.erase(string.find_last_not_of(' ') + 1);
-}
+	None,
+	UnknownCommand,
+	ArgumentCount,      // wrong number of arguments for the command
+	TooManyArguments,   // more than CommandMaxArguments
+	UnterminatedGroup,  // a '"' without a closing one
+	InvalidArgument,    // argument isn't a valid value for the parameter type
+	ArgumentOutOfRange, // argument is a number, but doesn't fit in the parameter type
+};
 
-// Within a string, for any pair of spaces '  ', erases one of them
-// "this is  a    string" -> "this is a string"
-static void string_collapse_whitespace(std::string& string)
+static const char* command_error_string(CommandError error)
 {
-	for (size_t i = 0; i < string.length(); i++)
+	switch (error)
 	{
-		char c0 = string[i];
-		char c1 = string[i + 1];
-		if (c0 == ' ' && c1 == ' ')
-			string.erase(i--, 1);
+	case CommandError::None:               return "no error";
+	case CommandError::UnknownCommand:     return "command doesn't exist";
+	case CommandError::ArgumentCount:      return "wrong number of arguments";
+	case CommandError::TooManyArguments:   return "too many arguments";
+	case CommandError::UnterminatedGroup:  return "expected a '\"' to close argument grouping";
+	case CommandError::InvalidArgument:    return "invalid argument";
+	case CommandError::ArgumentOutOfRange: return "argument out of range";
 	}
+	return "unknown error";
 }
 
-// You can add an explicit template specialization if you want arguments of a different type to be parsed
+// Outcome of parsing and invoking a command
+struct CommandResult
+{
+	CommandError error = CommandError::None;
+	uint32_t argument = 0; // index of the bad argument for InvalidArgument/ArgumentOutOfRange, number of arguments given for ArgumentCount
+	uint32_t expected = 0; // number of arguments the command takes, for ArgumentCount
+
+	operator bool() const { return error == CommandError::None; }
+};
+
+// A command in a script that failed
+struct ScriptError
+{
+	size_t line = 0; // 1-based
+	CommandResult result;
+};
+
+// Summary of CommandHandler::execute_script()
+struct ScriptResult
+{
+	bool opened = false;      // false if the file couldn't be opened, nothing else is filled in then
+	size_t commands = 0;      // non-empty, non-comment lines
+	size_t executed = 0;      // commands that ran successfully
+	double seconds = 0.0;
+	std::vector<ScriptError> errors;
+
+	double commands_per_second() const { return seconds > 0.0 ? commands / seconds : 0.0; }
+};
+
+// Value parsed from a single argument, or the reason it couldn't be parsed
 template<typename T>
-T command_parse_argument(const std::string& stringified);
+struct CommandArgument
+{
+	T value{};
+	CommandError error = CommandError::None;
+};
+
+// Returns the view with leading and trailing whitespace removed
+static std::string_view string_trim_whitespace(std::string_view string)
+{
+	size_t first = string.find_first_not_of(' ');
+	if (first == std::string_view::npos)
+		return {};
 
-template<>
-static int command_parse_argument(const std::string& s) {
-	return std::atoi(s.c_str());
+	return string.substr(first, string.find_last_not_of(' ') - first + 1);
 }
-template<>
-static unsigned int command_parse_argument(const std::string& s) {
-	return std::atoi(s.c_str());
+
+// Sends what commands print with command_printf() on this thread into output instead of stdout, for as long as it lives
+// Used by whatever runs commands for someone else (ie. ConsoleServer), so that caller gets the output back
+class CommandOutputCapture
+{
+public:
+	CommandOutputCapture(std::string& output)
+		: m_Previous(current())
+	{
+		current() = &output;
+	}
+	~CommandOutputCapture()
+	{
+		current() = m_Previous;
+	}
+
+	CommandOutputCapture(const CommandOutputCapture&) = delete;
+	CommandOutputCapture& operator=(const CommandOutputCapture&) = delete;
+
+	// Capture in effect on this thread, nullptr if output goes to stdout
+	static std::string* active() { return current(); }
+private:
+	static std::string*& current()
+	{
+		thread_local std::string* s_Output = nullptr;
+		return s_Output;
+	}
+private:
+	std::string* m_Previous;
+};
+
+// printf() for commands, goes to stdout or to the CommandOutputCapture active on this thread
+inline void command_printf(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	std::string* output = CommandOutputCapture::active();
+	if (!output)
+	{
+		vprintf(format, args);
+		va_end(args);
+		return;
+	}
+
+	va_list measure;
+	va_copy(measure, args);
+	int length = vsnprintf(nullptr, 0, format, measure);
+	va_end(measure);
+
+	if (length > 0)
+	{
+		size_t offset = output->size();
+		output->resize(offset + length + 1);
+		vsnprintf(output->data() + offset, length + 1, format, args);
+		output->resize(offset + length);
+	}
+	va_end(args);
 }
-template<>
-static float command_parse_argument(const std::string& s) {
-	return std::strtof(s.c_str(), nullptr);
+
+// Parses a command argument, handles every arithmetic type (bool as true/false/1/0), std::string and std::string_view
+// The whole argument has to be consumed, so "12abc" is rejected instead of being read as 12
+// You can add an explicit template specialization if you want arguments of a different type to be parsed
+// The view points into the command string, copy out of it if the result has to outlive the call
+template<typename T>
+CommandArgument<T> command_parse_argument(std::string_view s)
+{
+	CommandArgument<T> result;
+	if constexpr (std::is_same_v<T, bool>)
+	{
+		if (s == "true" || s == "1")
+			result.value = true;
+		else if (s == "false" || s == "0")
+			result.value = false;
+		else
+			result.error = CommandError::InvalidArgument;
+	}
+	else if constexpr (std::is_arithmetic_v<T>)
+	{
+		// from_chars doesn't take an explicit '+'
+		if (s.size() > 1 && s[0] == '+' && s[1] != '-')
+			s.remove_prefix(1);
+
+		const char* end = s.data() + s.size();
+		auto [ptr, ec] = std::from_chars(s.data(), end, result.value);
+		if (ec == std::errc::result_out_of_range)
+			result.error = CommandError::ArgumentOutOfRange;
+		else if (ec != std::errc() || ptr != end)
+			result.error = CommandError::InvalidArgument;
+	}
+	else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+	{
+		result.value = T(s);
+	}
+	else
+	{
+		static_assert(sizeof(T) == 0, "no command_parse_argument for this type, add a specialization");
+	}
+
+	return result;
 }
-template<>
-static std::string command_parse_argument(const std::string& s) { return s; }
-template<>
-static const std::string& command_parse_argument(const std::string& s) { return s; }
 
 // Offers ability to bind a function void(*)(...), and invoke it using a string containing the name and arguments separated by a space
+// Parsing works on views into the command string, so invoking a command doesn't allocate (unless it takes std::string arguments)
 class CommandHandler
 {
 private:
 	struct ICommand
 	{
-		virtual bool invoke(const std::vector<std::string>&) = 0;
+		virtual ~ICommand() = default;
+		virtual CommandResult invoke(const std::string_view* arguments, size_t count) = 0;
 	};
 
 	template<typename... Args>
@@ -65,114 +215,602 @@ private:
 		Command(Callback c)
 			: callback(c) {}
 
-		bool invoke(const std::vector<std::string>& arguments) override
+		CommandResult invoke(const std::string_view* arguments, size_t count) override
 		{
 			constexpr size_t expectedArgs = sizeof...(Args);
-			if (arguments.size() != expectedArgs) {
-				printf("command expects %zu arguments, got %zu\n", expectedArgs, arguments.size());
-				return false;
-			}
+			if (count != expectedArgs)
+				return { CommandError::ArgumentCount, uint32_t(count), uint32_t(expectedArgs) };
 
-			invoke_internal(arguments, std::index_sequence_for<Args...>{});
-			return true;
+			return invoke_internal(arguments, std::index_sequence_for<Args...>{});
 		}
 	private:
 		template<size_t... Is>
-		void invoke_internal(const std::vector<std::string>& args, std::index_sequence<Is...>)
+		CommandResult invoke_internal(const std::string_view* args, std::index_sequence<Is...>)
 		{
-			callback(command_parse_argument<Args>(args[Is])...);
+			// Parsed as the decayed type so ie. 'const std::string&' parameters bind to a temporary std::string
+			// Everything is parsed before calling, a bad argument means the callback doesn't run at all
+			std::tuple<CommandArgument<std::decay_t<Args>>...> parsed{ command_parse_argument<std::decay_t<Args>>(args[Is])... };
+
+			CommandError errors[] = { std::get<Is>(parsed).error..., CommandError::None };
+			for (uint32_t i = 0; i < sizeof...(Args); i++)
+			{
+				if (errors[i] != CommandError::None)
+					return { errors[i], i };
+			}
+
+			callback(std::move(std::get<Is>(parsed).value)...);
+			return {};
 		}
 	};
 
-	std::unordered_map<std::string, std::unique_ptr<ICommand>> command_hash_to_callback_map;
+	// Lets the map be searched with a std::string_view without building a std::string
+	struct CommandNameHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+	};
+
+	std::unordered_map<std::string, std::unique_ptr<ICommand>, CommandNameHash, std::equal_to<>> command_hash_to_callback_map;
+
+	// Slot in the frozen table, names are packed into m_FrozenNames
+	struct FrozenEntry
+	{
+		uint32_t name_offset = 0;
+		uint32_t name_length = 0;
+		ICommand* command = nullptr;
+	};
+
+	// Prefix tree over the command names, children of a node are a linked list through next_sibling, sorted by character
+	struct TrieNode
+	{
+		static constexpr uint32_t None = ~0u;
+
+		char character = 0;
+		uint32_t first_child = None;
+		uint32_t next_sibling = None;
+		uint32_t entry = None; // into m_FrozenEntries if a name ends here
+	};
+
+	bool m_Frozen = false;
+	std::vector<FrozenEntry> m_FrozenEntries; // indexed by perfect hash slot
+	std::vector<uint32_t> m_FrozenSeeds;      // per hash bucket, picks the slot of every name in the bucket
+	std::string m_FrozenNames;
+	std::vector<TrieNode> m_Trie;             // [0] is the root
+public:
+	// A command that has been looked up and split into arguments, but not invoked yet
+	// Owns its text, so it can be prepared on one thread and invoked later on another (see CommandQueue)
+	class PreparedCommand
+	{
+	public:
+		std::string_view text() const { return m_Text; }
+		CommandError error() const { return m_Error; }
+	private:
+		friend class CommandHandler;
+
+		std::string m_Text;
+		ICommand* m_Command = nullptr;
+		CommandError m_Error = CommandError::None;
+		uint32_t m_ArgumentCount = 0;
+		uint32_t m_Arguments[CommandMaxArguments][2] = {}; // [offset, length] into m_Text, views would dangle when the string moves
+	};
 public:
 	// Bind a callback (with or without arguments) to a string for the command name
 	template<typename... Args>
 	void listen_for(const std::string& name, void(*callback)(Args...))
 	{
+		static_assert(sizeof...(Args) <= CommandMaxArguments, "too many command arguments");
 		command_hash_to_callback_map.emplace(name, std::make_unique<Command<Args...>>(callback));
+
+		// The frozen tables don't know about the new command, back to the map until freeze() is called again
+		unfreeze();
+	}
+
+	bool command_exists(std::string_view name) const
+	{
+		return find_command(name);
+	}
+
+	// Call once every command is registered
+	// Builds a minimal perfect hash over the names, so a lookup is a single hash of the name, one slot in a flat array and one compare,
+	// and a prefix tree for complete() and suggest()
+	void freeze()
+	{
+		unfreeze();
+
+		std::vector<std::pair<std::string_view, ICommand*>> commands;
+		for (auto& [name, command] : command_hash_to_callback_map)
+			commands.emplace_back(name, command.get());
+
+		// Sorted so the trie's children come out in order
+		std::sort(commands.begin(), commands.end());
+
+		std::vector<size_t> hashes;
+		for (auto& [name, command] : commands)
+			hashes.push_back(CommandNameHash{}(name));
+
+		// With ~2 names per bucket a seed is found within a handful of tries, fewer names per bucket if that ever fails
+		size_t bucket_count = commands.size() / 2 + 1;
+		std::vector<uint32_t> slots;
+		while (!build_perfect_hash(hashes, bucket_count, slots))
+			bucket_count *= 2;
+
+		m_FrozenEntries.resize(commands.size());
+		m_Trie.emplace_back(); // root
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			std::string_view name = commands[i].first;
+
+			FrozenEntry& entry = m_FrozenEntries[slots[i]];
+			entry.name_offset = static_cast<uint32_t>(m_FrozenNames.size());
+			entry.name_length = static_cast<uint32_t>(name.size());
+			entry.command = commands[i].second;
+			m_FrozenNames += name;
+
+			trie_insert(name, slots[i]);
+		}
+
+		m_Frozen = true;
 	}
 
-	bool command_exists(const std::string& name) const
+	bool is_frozen() const { return m_Frozen; }
+
+	// Calls visit(name) for every command name starting with prefix, in alphabetical order, without building a list
+	// The views stay valid until the next listen_for() or freeze()
+	void for_each_completion(std::string_view prefix, function_ref<void(std::string_view)> visit) const
 	{
-		return command_hash_to_callback_map.count(name);
+		if (!m_Frozen)
+		{
+			// Only the frozen trie keeps names in order
+			std::vector<std::string_view> names;
+			for (auto& [name, command] : command_hash_to_callback_map)
+			{
+				if (std::string_view(name).substr(0, prefix.size()) == prefix)
+					names.push_back(name);
+			}
+			std::sort(names.begin(), names.end());
+
+			for (std::string_view name : names)
+				visit(name);
+			return;
+		}
+
+		uint32_t node = trie_find(prefix);
+		if (node == TrieNode::None)
+			return;
+
+		// Depth first, children before siblings, which visits names in order
+		if (m_Trie[node].entry != TrieNode::None)
+			visit(frozen_name(m_FrozenEntries[m_Trie[node].entry]));
+
+		std::vector<uint32_t> stack;
+		if (m_Trie[node].first_child != TrieNode::None)
+			stack.push_back(m_Trie[node].first_child);
+
+		while (!stack.empty())
+		{
+			const TrieNode& current = m_Trie[stack.back()];
+			stack.pop_back();
+
+			if (current.entry != TrieNode::None)
+				visit(frozen_name(m_FrozenEntries[current.entry]));
+			if (current.next_sibling != TrieNode::None)
+				stack.push_back(current.next_sibling);
+			if (current.first_child != TrieNode::None)
+				stack.push_back(current.first_child);
+		}
+	}
+
+	// Every command name starting with prefix, in alphabetical order
+	// The views stay valid until the next listen_for() or freeze()
+	std::vector<std::string_view> complete(std::string_view prefix) const
+	{
+		std::vector<std::string_view> result;
+		for_each_completion(prefix, [&](std::string_view name) { result.push_back(name); });
+		return result;
+	}
+
+	// Commands sharing the longest possible prefix with name, for "did you mean" hints after a typo
+	// Empty if not even the first character matches anything
+	std::vector<std::string_view> suggest(std::string_view name, size_t max_suggestions = 4) const
+	{
+		std::vector<std::string_view> result;
+		for (size_t length = name.size(); length > 0 && result.empty(); length--)
+			result = complete(name.substr(0, length));
+
+		if (result.size() > max_suggestions)
+			result.resize(max_suggestions);
+		return result;
 	}
 
-	// Parses a command string and tries to invoke the corresponding command
+	// Parses a command string and tries to invoke the corresponding command, printing what went wrong if it couldn't
 	// Returns: true if invoked successfully, false if an error occurred (invalid command, incorrect arguments, etc)
-	bool parse_and_invoke_command(std::string raw) const
+	bool parse_and_invoke_command(std::string_view raw) const
+	{
+		CommandResult result = try_invoke_command(raw);
+		if (!result)
+		{
+			print_command_error(result, raw);
+			if (result.error == CommandError::UnknownCommand)
+				print_suggestions(raw);
+		}
+
+		return result;
+	}
+
+	// Same as parse_and_invoke_command(), but reports errors to the caller instead of printing them
+	// If any argument fails to parse, the command isn't invoked
+	CommandResult try_invoke_command(std::string_view raw) const
 	{
-		// Preprocess string
-		string_trim_whitespace(raw);
-		string_collapse_whitespace(raw);
+		raw = string_trim_whitespace(raw);
 
 		size_t first_space = raw.find_first_of(' ');
-		bool has_arguments = first_space != std::string::npos;
+		std::string_view name = raw.substr(0, first_space);
 
-		std::string name = raw.substr(0, first_space);
-		if (!command_exists(name)) {
-			printf("command '%s' doesn't exist\n", name.c_str());
-			return false;
+		ICommand* command = find_command(name);
+		if (!command)
+			return { CommandError::UnknownCommand };
+
+		return invoke_with_arguments(command, raw, first_space);
+	}
+
+	// Looks up the command and splits its arguments without running it, errors are kept in the result and reported by invoke()
+	// Only reads the handler, so it's safe from any thread as long as nothing calls listen_for() at the same time
+	PreparedCommand prepare(std::string_view raw) const
+	{
+		PreparedCommand prepared;
+		prepared.m_Text = string_trim_whitespace(raw);
+
+		std::string_view text = prepared.m_Text;
+		size_t first_space = text.find_first_of(' ');
+		prepared.m_Command = find_command(text.substr(0, first_space));
+		if (!prepared.m_Command)
+		{
+			prepared.m_Error = CommandError::UnknownCommand;
+			return prepared;
 		}
 
-		// Extract arguments
-		std::vector<std::string> args;
-		if (has_arguments)
+		if (first_space != std::string_view::npos)
 		{
-			std::string arguments_string = raw.substr(raw.find_first_not_of(' ', first_space));
-			bool success = extract_command_arguments_from_string(arguments_string, args);
+			std::string_view args[CommandMaxArguments];
+			size_t arg_count = 0;
+			prepared.m_Error = extract_command_arguments_from_string(text.substr(first_space), args, arg_count);
+
+			prepared.m_ArgumentCount = static_cast<uint32_t>(arg_count);
+			for (size_t i = 0; i < arg_count; i++)
+			{
+				prepared.m_Arguments[i][0] = static_cast<uint32_t>(args[i].data() - text.data());
+				prepared.m_Arguments[i][1] = static_cast<uint32_t>(args[i].size());
+			}
+		}
+
+		return prepared;
+	}
+
+	// Runs a command made by prepare() on this handler
+	CommandResult invoke(const PreparedCommand& prepared) const
+	{
+		if (prepared.m_Error != CommandError::None)
+			return { prepared.m_Error };
+
+		std::string_view args[CommandMaxArguments];
+		for (uint32_t i = 0; i < prepared.m_ArgumentCount; i++)
+			args[i] = std::string_view(prepared.m_Text).substr(prepared.m_Arguments[i][0], prepared.m_Arguments[i][1]);
+
+		return prepared.m_Command->invoke(args, prepared.m_ArgumentCount);
+	}
+
+	// Runs every line of a file as a command, in order
+	// The file is memory-mapped and lines are found with a vectorized newline scan, so nothing is copied
+	// Empty lines and lines starting with '#' are skipped, failing commands are collected in the result instead of printed
+	ScriptResult execute_script(const std::string& path) const
+	{
+		ScriptResult result;
+
+		MappedFile file;
+		if (!file.open(path))
+			return result;
+		result.opened = true;
+
+		const char* data = reinterpret_cast<const char*>(file.data());
+		size_t size = file.size();
+
+		// Every distinct name is looked up once, names are views into the mapped file and unknown ones are kept as nullptr
+		// Scripts tend to repeat the same command many times in a row, those skip even the map
+		std::unordered_map<std::string_view, ICommand*> resolved;
+		std::string_view last_name;
+		ICommand* last_command = nullptr;
+		bool has_last = false;
+
+		auto start = std::chrono::steady_clock::now();
+
+		size_t line_number = 0;
+		for (size_t position = 0; position < size;)
+		{
+			size_t line_end = position + simd_find(data + position, size - position, '\n');
+			std::string_view line(data + position, line_end - position);
+			position = line_end + 1;
+			line_number++;
+
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+
+			line = string_trim_whitespace(line);
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			result.commands++;
 
-			if (!success)
-				return false; // failed to parse args
+			size_t first_space = line.find_first_of(' ');
+			std::string_view name = line.substr(0, first_space);
+			if (!has_last || name != last_name)
+			{
+				auto [it, inserted] = resolved.try_emplace(name, nullptr);
+				if (inserted)
+					it->second = find_command(name);
+
+				last_name = name;
+				last_command = it->second;
+				has_last = true;
+			}
+
+			CommandResult command_result = last_command ? invoke_with_arguments(last_command, line, first_space) : CommandResult{ CommandError::UnknownCommand };
+			if (command_result)
+				result.executed++;
+			else
+				result.errors.push_back({ line_number, command_result });
 		}
 
-		const auto& prototype = command_hash_to_callback_map.at(name);
-		return prototype->invoke(args);
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	}
+
+	// Prints a readable description of why raw failed
+	static void print_command_error(const CommandResult& result, std::string_view raw)
+	{
+		printf("%s\n", command_error_message(result, raw).c_str());
+	}
+
+	// Readable description of why raw failed, without a trailing newline
+	static std::string command_error_message(const CommandResult& result, std::string_view raw)
+	{
+		raw = string_trim_whitespace(raw);
+		std::string_view name = raw.substr(0, raw.find_first_of(' '));
+
+		char buffer[256];
+		switch (result.error)
+		{
+		case CommandError::UnknownCommand:
+			snprintf(buffer, sizeof(buffer), "command '%.*s' doesn't exist", (int)name.size(), name.data());
+			break;
+		case CommandError::ArgumentCount:
+			snprintf(buffer, sizeof(buffer), "command expects %u arguments, got %u", result.expected, result.argument);
+			break;
+		case CommandError::TooManyArguments:
+			snprintf(buffer, sizeof(buffer), "too many arguments (max %zu)", CommandMaxArguments);
+			break;
+		case CommandError::InvalidArgument:
+		case CommandError::ArgumentOutOfRange:
+			snprintf(buffer, sizeof(buffer), "'%.*s' argument %u: %s", (int)name.size(), name.data(), result.argument + 1, command_error_string(result.error));
+			break;
+		default:
+			snprintf(buffer, sizeof(buffer), "%s", command_error_string(result.error));
+			break;
+		}
+
+		return buffer;
 	}
 private:
-	// Parses a string of arguments and populates a vector with each argument split at a space
-	// Surround arguments with quotations to group into one, irrespective of any spaces they contain
-	static bool extract_command_arguments_from_string(const std::string& raw, std::vector<std::string>& result)
+	ICommand* find_command(std::string_view name) const
+	{
+		if (m_Frozen)
+		{
+			if (m_FrozenEntries.empty())
+				return nullptr;
+
+			size_t hash = CommandNameHash{}(name);
+			const FrozenEntry& entry = m_FrozenEntries[perfect_hash_slot(hash, m_FrozenSeeds[hash % m_FrozenSeeds.size()], m_FrozenEntries.size())];
+			return frozen_name(entry) == name ? entry.command : nullptr;
+		}
+
+		auto it = command_hash_to_callback_map.find(name);
+		return it != command_hash_to_callback_map.end() ? it->second.get() : nullptr;
+	}
+
+	void print_suggestions(std::string_view raw) const
+	{
+		raw = string_trim_whitespace(raw);
+		std::vector<std::string_view> suggestions = suggest(raw.substr(0, raw.find_first_of(' ')));
+		if (suggestions.empty())
+			return;
+
+		printf("did you mean:");
+		for (std::string_view suggestion : suggestions)
+			printf(" %.*s", (int)suggestion.size(), suggestion.data());
+		printf("\n");
+	}
+
+	void unfreeze()
+	{
+		m_Frozen = false;
+		m_FrozenEntries.clear();
+		m_FrozenSeeds.clear();
+		m_FrozenNames.clear();
+		m_Trie.clear();
+	}
+
+	// The name's hash is only computed once, the seed just remixes it
+	static size_t perfect_hash_slot(size_t hash, uint32_t seed, size_t slot_count)
 	{
-		// Might over-reserve if arguments contain a space
-		result.reserve(std::count(raw.begin(), raw.end(), ' '));
+		uint64_t x = static_cast<uint64_t>(hash) ^ (seed * 0x9E3779B97F4A7C15ull);
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDull;
+		x ^= x >> 33;
+		return static_cast<size_t>(x % slot_count);
+	}
+
+	// Hash and displace: names are grouped into buckets by hash, then biggest bucket first,
+	// each bucket gets the first seed that sends all of its names to slots nobody has taken yet
+	// Fills slots (per name) and m_FrozenSeeds, returns false if some bucket ran out of seeds to try
+	bool build_perfect_hash(const std::vector<size_t>& hashes, size_t bucket_count, std::vector<uint32_t>& slots)
+	{
+		const uint32_t MaxSeed = 1 << 16;
+		size_t count = hashes.size();
+
+		std::vector<std::vector<uint32_t>> buckets(bucket_count);
+		for (uint32_t i = 0; i < count; i++)
+			buckets[hashes[i] % bucket_count].push_back(i);
+
+		std::vector<uint32_t> order(bucket_count);
+		for (uint32_t i = 0; i < bucket_count; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		m_FrozenSeeds.assign(bucket_count, 0);
+		slots.assign(count, 0);
+		std::vector<bool> taken(count, false);
+		for (uint32_t bucket : order)
+		{
+			const std::vector<uint32_t>& names = buckets[bucket];
+			if (names.empty())
+				break; // sorted by size, the rest are empty too
+
+			bool placed = false;
+			for (uint32_t seed = 0; seed < MaxSeed && !placed; seed++)
+			{
+				placed = true;
+				for (size_t i = 0; i < names.size() && placed; i++)
+				{
+					slots[names[i]] = static_cast<uint32_t>(perfect_hash_slot(hashes[names[i]], seed, count));
+					if (taken[slots[names[i]]])
+						placed = false;
+
+					// Two names of the same bucket can't share a slot either
+					for (size_t j = 0; j < i && placed; j++)
+					{
+						if (slots[names[j]] == slots[names[i]])
+							placed = false;
+					}
+				}
+
+				if (placed)
+					m_FrozenSeeds[bucket] = seed;
+			}
+
+			if (!placed)
+				return false;
+
+			for (uint32_t name : names)
+				taken[slots[name]] = true;
+		}
+
+		return true;
+	}
+
+	// Names have to be inserted in sorted order, new children always go at the end of the sibling list
+	void trie_insert(std::string_view name, uint32_t entry)
+	{
+		uint32_t node = 0;
+		for (char c : name)
+		{
+			uint32_t child = m_Trie[node].first_child;
+			uint32_t last = TrieNode::None;
+			while (child != TrieNode::None && m_Trie[child].character != c)
+			{
+				last = child;
+				child = m_Trie[child].next_sibling;
+			}
+
+			if (child == TrieNode::None)
+			{
+				child = static_cast<uint32_t>(m_Trie.size());
+				m_Trie.emplace_back().character = c;
+				if (last == TrieNode::None)
+					m_Trie[node].first_child = child;
+				else
+					m_Trie[last].next_sibling = child;
+			}
+			node = child;
+		}
 
+		m_Trie[node].entry = entry;
+	}
+
+	uint32_t trie_find(std::string_view prefix) const
+	{
+		uint32_t node = 0;
+		for (char c : prefix)
+		{
+			uint32_t child = m_Trie[node].first_child;
+			while (child != TrieNode::None && m_Trie[child].character != c)
+				child = m_Trie[child].next_sibling;
+
+			if (child == TrieNode::None)
+				return TrieNode::None;
+			node = child;
+		}
+		return node;
+	}
+
+	std::string_view frozen_name(const FrozenEntry& entry) const
+	{
+		return std::string_view(m_FrozenNames).substr(entry.name_offset, entry.name_length);
+	}
+
+	// raw is the trimmed command string, first_space where its arguments start (npos if there are none)
+	static CommandResult invoke_with_arguments(ICommand* command, std::string_view raw, size_t first_space)
+	{
+		std::string_view args[CommandMaxArguments];
+		size_t arg_count = 0;
+		if (first_space != std::string_view::npos)
+		{
+			CommandError error = extract_command_arguments_from_string(raw.substr(first_space), args, arg_count);
+			if (error != CommandError::None)
+				return { error }; // failed to parse args
+		}
+
+		return command->invoke(args, arg_count);
+	}
+
+	// Splits a string of arguments at spaces into views over the same string, runs of spaces count as one
+	// Surround arguments with quotations to group into one, irrespective of any spaces they contain
+	static CommandError extract_command_arguments_from_string(std::string_view raw, std::string_view* result, size_t& count)
+	{
 		// A string wrapped in this character will be treated as a single argument, even if there are spaces within it
 		const char GroupingCharacter = '"';
 
+		count = 0;
 		for (size_t i = 0; i < raw.size(); i++)
 		{
 			char c = raw[i];
+			if (c == ' ')
+				continue;
+
+			if (count == CommandMaxArguments)
+				return CommandError::TooManyArguments;
+
 			if (c == GroupingCharacter)
 			{
 				size_t groupEnd = raw.find_first_of(GroupingCharacter, i + 1);
-				if (groupEnd == std::string::npos) {
-					printf("expected a '%c' to close argument grouping\n", GroupingCharacter);
-					return false;
-				}
+				if (groupEnd == std::string_view::npos)
+					return CommandError::UnterminatedGroup;
 
 				size_t argStart = i + 1;
-				result.emplace_back(raw.substr(argStart, groupEnd - argStart));
-				i = groupEnd + 1;
+				result[count++] = raw.substr(argStart, groupEnd - argStart);
+				i = groupEnd;
 				continue;
 			}
 
-			if (c != ' ')
-			{
-				size_t nextSpace = raw.find_first_of(' ', i + 1);
-
-				if (nextSpace == std::string::npos) {
-					// Last argument
-					result.emplace_back(raw.substr(i));
-					break;
-				}
-
-				result.emplace_back(raw.substr(i, nextSpace - i));
-				i = nextSpace;
+			size_t nextSpace = raw.find_first_of(' ', i + 1);
+			if (nextSpace == std::string_view::npos) {
+				// Last argument
+				result[count++] = raw.substr(i);
+				break;
 			}
+
+			result[count++] = raw.substr(i, nextSpace - i);
+			i = nextSpace;
 		}
 
-		result.shrink_to_fit();
-		return true;
+		return CommandError::None;
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Command.h"
+#include "MPSCQueue.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Moves command input off the simulation thread
+// Any thread can submit() commands, they're looked up and split into arguments right there and queued,
+// the simulation thread then calls drain() once per tick to run what's waiting, up to a fixed number per tick
+// so a burst of input is spread over a few ticks instead of stalling one
+// Commands must all be registered with the handler before anything is submitted
+class CommandQueue
+{
+private:
+	// Shared with the stdin reader, which can outlive the queue (it's detached if still blocked on input)
+	struct State
+	{
+		const CommandHandler& handler;
+		MPSCQueue<CommandHandler::PreparedCommand> queue;
+		std::atomic<bool> input_closed = false;
+		std::atomic<bool> stopping = false;
+		std::mutex reader_lock; // held by the reader while it uses handler, so the destructor can wait it out
+
+		State(const CommandHandler& h)
+			: handler(h) {}
+	};
+public:
+	CommandQueue(const CommandHandler& handler)
+		: m_State(std::make_shared<State>(handler))
+	{
+	}
+	~CommandQueue()
+	{
+		if (!m_Reader.joinable())
+			return;
+
+		{
+			std::lock_guard lock(m_State->reader_lock);
+			m_State->stopping.store(true, std::memory_order_relaxed);
+		}
+
+		if (m_State->input_closed.load(std::memory_order_acquire))
+			m_Reader.join();
+		else
+			m_Reader.detach(); // blocked in getline, there's no portable way to wake it
+	}
+
+	CommandQueue(const CommandQueue&) = delete;
+	CommandQueue& operator=(const CommandQueue&) = delete;
+
+	// Safe from any thread
+	void submit(std::string_view raw)
+	{
+		submit(*m_State, raw);
+	}
+
+	// Starts a thread reading commands from stdin, one per line, input_closed() turns true at end of input
+	void read_stdin()
+	{
+		if (m_Reader.joinable())
+			return; // already reading
+
+		m_Reader = std::thread([state = m_State]() {
+			std::string line;
+			while (std::getline(std::cin, line))
+			{
+				// The handler may be gone once the queue is destroyed
+				std::lock_guard lock(state->reader_lock);
+				if (state->stopping.load(std::memory_order_relaxed))
+					return;
+
+				submit(*state, line);
+			}
+
+			state->input_closed.store(true, std::memory_order_release);
+		});
+	}
+
+	// Whether the stdin reader has hit the end of input, everything it read is in the queue by then
+	bool input_closed() const
+	{
+		return m_State->input_closed.load(std::memory_order_acquire);
+	}
+
+	// Runs up to budget queued commands on the calling thread, in the order they were submitted (per producer)
+	// Failing commands have their error printed
+	// Only one thread may drain, returns the number of commands taken off the queue
+	size_t drain(size_t budget)
+	{
+		return drain(budget, CommandHandler::print_command_error);
+	}
+
+	// Same as drain(budget), but failing commands are handed to on_error(result, text) instead of being printed
+	size_t drain(size_t budget, function_ref<void(const CommandResult&, std::string_view)> on_error)
+	{
+		CommandHandler::PreparedCommand command;
+
+		size_t count = 0;
+		while (count < budget && m_State->queue.try_pop(command))
+		{
+			CommandResult result = m_State->handler.invoke(command);
+			if (!result)
+				on_error(result, command.text());
+			count++;
+		}
+
+		return count;
+	}
+private:
+	static void submit(State& state, std::string_view raw)
+	{
+		if (string_trim_whitespace(raw).empty())
+			return;
+
+		state.queue.push(state.handler.prepare(raw));
+	}
+private:
+	std::shared_ptr<State> m_State;
+	std::thread m_Reader;
+};
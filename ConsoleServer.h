@@ -0,0 +1,556 @@
+#pragma once
+
+#ifdef __linux__
+
+#include "Command.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Runs commands sent by local tools over a Unix domain socket, any number of clients at once
+// Clients send one command per line and get a response per command, in order: whatever the command printed with
+// command_printf(), one "> <text>" line per line of output, followed by "ok" or "error: <description>"
+// Everything is non-blocking, poll() waits on epoll and runs whatever commands have fully arrived on the calling thread,
+// so it slots into a tick loop with a timeout of 0
+// Plain printf() from a command still goes to this process' stdout
+class ConsoleServer
+{
+private:
+	// Longest line a client can send, a client going over is disconnected
+	static constexpr size_t MaxLineLength = 4096;
+	// Responses a client hasn't read yet, past this its input isn't looked at until it catches up
+	static constexpr size_t MaxPendingOutput = 1024 * 1024;
+
+	struct Client
+	{
+		int fd = -1;
+		std::string input;
+		std::string output;
+		size_t output_offset = 0; // sent part of output
+		uint32_t events = 0;      // currently registered with epoll
+		bool closed = false;      // peer hung up or errored, dropped once its output is flushed
+		bool pending = false;     // has complete lines left over because poll() ran out of budget
+	};
+public:
+	ConsoleServer() = default;
+	~ConsoleServer()
+	{
+		close();
+	}
+
+	ConsoleServer(const ConsoleServer&) = delete;
+	ConsoleServer& operator=(const ConsoleServer&) = delete;
+
+	// Starts listening at path, a stale socket file left behind at path is replaced
+	bool listen(const std::string& path)
+	{
+		close();
+
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			return false;
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+		m_Listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (m_Listener < 0)
+			return false;
+
+		unlink(path.c_str());
+		if (bind(m_Listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_Listener, SOMAXCONN) != 0)
+		{
+			close();
+			return false;
+		}
+		m_Path = path;
+
+		m_Epoll = epoll_create1(EPOLL_CLOEXEC);
+		if (m_Epoll < 0)
+		{
+			close();
+			return false;
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = m_Listener;
+		epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Listener, &event);
+		return true;
+	}
+
+	// Disconnects every client and removes the socket file
+	void close()
+	{
+		for (auto& [fd, client] : m_Clients)
+			::close(fd);
+		m_Clients.clear();
+
+		if (m_Epoll >= 0)
+			::close(m_Epoll);
+		if (m_Listener >= 0)
+			::close(m_Listener);
+		if (!m_Path.empty())
+			unlink(m_Path.c_str());
+
+		m_Epoll = -1;
+		m_Listener = -1;
+		m_Path.clear();
+	}
+
+	// Waits up to timeout_ms (0 returns right away, -1 waits forever) for activity, accepts new clients and runs received commands
+	// At most max_commands run per call, so one client sending a big batch can't stall the tick, the rest waits for the next poll()
+	// Returns the number of commands run
+	size_t poll(const CommandHandler& handler, int timeout_ms = 0, size_t max_commands = ~size_t(0))
+	{
+		if (m_Epoll < 0)
+			return 0;
+
+		// Input left over from the last call is already here, don't wait for more
+		epoll_event events[64];
+		int count = epoll_wait(m_Epoll, events, 64, m_Pending.empty() ? timeout_ms : 0);
+
+		size_t executed = 0;
+
+		// Clients cut off by the budget last time go first, in the order they were cut off
+		std::vector<int> pending;
+		pending.swap(m_Pending);
+		for (int fd : pending)
+		{
+			auto it = m_Clients.find(fd);
+			if (it == m_Clients.end())
+				continue;
+
+			it->second.pending = false;
+			executed += serve(handler, it->second, max_commands - executed);
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			int fd = events[i].data.fd;
+			if (fd == m_Listener)
+			{
+				accept_clients();
+				continue;
+			}
+
+			auto it = m_Clients.find(fd);
+			if (it == m_Clients.end())
+				continue;
+			Client& client = it->second;
+
+			if (events[i].events & EPOLLOUT)
+				flush(client);
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+				receive(client);
+
+			executed += serve(handler, client, max_commands - executed);
+		}
+
+		return executed;
+	}
+
+	bool is_listening() const { return m_Listener >= 0; }
+	size_t client_count() const { return m_Clients.size(); }
+	const std::string& path() const { return m_Path; }
+private:
+	void accept_clients()
+	{
+		while (true)
+		{
+			int fd = accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0)
+				return; // EAGAIN once the backlog is empty
+
+			Client& client = m_Clients[fd];
+			client.fd = fd;
+			client.events = EPOLLIN | EPOLLRDHUP;
+
+			epoll_event event = {};
+			event.events = client.events;
+			event.data.fd = fd;
+			epoll_ctl(m_Epoll, EPOLL_CTL_ADD, fd, &event);
+		}
+	}
+
+	// Runs up to budget of the client's commands, sends what it can of the responses and drops or re-arms the client
+	// May disconnect the client, don't use it afterwards
+	size_t serve(const CommandHandler& handler, Client& client, size_t budget)
+	{
+		size_t executed = run_commands(handler, client, budget);
+		flush(client);
+
+		if (!client.pending && has_complete_line(client) && !backlogged(client))
+		{
+			client.pending = true;
+			m_Pending.push_back(client.fd);
+		}
+
+		if (client.closed && client.output_offset == client.output.size() && !client.pending)
+			disconnect(client);
+		else
+			update_events(client);
+
+		return executed;
+	}
+
+	void receive(Client& client)
+	{
+		if (backlogged(client))
+			return;
+
+		char buffer[16 * 1024];
+		while (true)
+		{
+			ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+			if (received > 0)
+			{
+				client.input.append(buffer, received);
+				continue;
+			}
+
+			if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+				client.closed = true;
+			if (received < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+	}
+
+	// Runs up to budget complete lines of the client's input and queues up the responses
+	size_t run_commands(const CommandHandler& handler, Client& client, size_t budget)
+	{
+		size_t executed = 0;
+		size_t position = 0;
+		while (executed < budget && position < client.input.size() && !backlogged(client))
+		{
+			const char* data = client.input.data() + position;
+			size_t remaining = client.input.size() - position;
+			size_t line_length = simd_find(data, remaining, '\n');
+			if (line_length > MaxLineLength)
+			{
+				drop_for_long_line(client);
+				return executed;
+			}
+			if (line_length == remaining)
+				break; // rest of the line hasn't arrived yet
+
+			std::string_view line(data, line_length);
+			position += line_length + 1;
+
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			if (string_trim_whitespace(line).empty())
+				continue;
+
+			m_Captured.clear();
+			CommandResult result;
+			{
+				CommandOutputCapture capture(m_Captured);
+				result = handler.try_invoke_command(line);
+			}
+			append_captured(client);
+
+			if (result)
+			{
+				client.output += "ok\n";
+			}
+			else
+			{
+				client.output += "error: ";
+				client.output += CommandHandler::command_error_message(result, line);
+				client.output += '\n';
+			}
+			executed++;
+		}
+
+		client.input.erase(0, position);
+		return executed;
+	}
+
+	// Output of the command that just ran, every line prefixed so clients can tell it from the "ok"/"error" that ends a response
+	void append_captured(Client& client)
+	{
+		size_t position = 0;
+		while (position < m_Captured.size())
+		{
+			size_t newline = m_Captured.find('\n', position);
+			size_t end = newline == std::string::npos ? m_Captured.size() : newline;
+
+			client.output += "> ";
+			client.output.append(m_Captured, position, end - position);
+			client.output += '\n';
+			position = end + 1;
+		}
+	}
+
+	static bool has_complete_line(const Client& client)
+	{
+		return simd_find(client.input.data(), client.input.size(), '\n') < client.input.size();
+	}
+
+	void drop_for_long_line(Client& client)
+	{
+		client.output += "error: line too long\n";
+		client.input.clear();
+		client.closed = true;
+	}
+
+	void flush(Client& client)
+	{
+		while (client.output_offset < client.output.size())
+		{
+			ssize_t sent = send(client.fd, client.output.data() + client.output_offset, client.output.size() - client.output_offset, MSG_NOSIGNAL);
+			if (sent > 0)
+			{
+				client.output_offset += sent;
+				continue;
+			}
+
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				// Nobody left to read the responses
+				client.closed = true;
+				client.output_offset = client.output.size();
+			}
+			break;
+		}
+
+		if (client.output_offset == client.output.size())
+		{
+			client.output.clear();
+			client.output_offset = 0;
+		}
+	}
+
+	// Only asks epoll for what the client can act on: no reads while backlogged, writes only with output pending
+	void update_events(Client& client)
+	{
+		uint32_t events = EPOLLRDHUP;
+		if (!backlogged(client) && !client.closed)
+			events |= EPOLLIN;
+		if (client.output_offset < client.output.size())
+			events |= EPOLLOUT;
+
+		if (events == client.events)
+			return;
+
+		epoll_event event = {};
+		event.events = events;
+		event.data.fd = client.fd;
+		epoll_ctl(m_Epoll, EPOLL_CTL_MOD, client.fd, &event);
+		client.events = events;
+	}
+
+	void disconnect(Client& client)
+	{
+		int fd = client.fd;
+		epoll_ctl(m_Epoll, EPOLL_CTL_DEL, fd, nullptr);
+		::close(fd);
+		m_Clients.erase(fd);
+	}
+
+	static bool backlogged(const Client& client)
+	{
+		return client.output.size() - client.output_offset >= MaxPendingOutput;
+	}
+private:
+	int m_Listener = -1;
+	int m_Epoll = -1;
+	std::string m_Path;
+	std::unordered_map<int, Client> m_Clients; // [fd, client]
+	std::vector<int> m_Pending;                // clients with commands left over for the next poll()
+	std::string m_Captured;                    // output of the command being run
+};
+
+// Result of ConsoleLoadGenerator::run()
+struct ConsoleLoadResult
+{
+	bool connected = false; // false if any client couldn't connect, nothing else is filled in then
+	size_t commands = 0;
+	size_t errors = 0;      // responses that weren't "ok"
+	double seconds = 0.0;
+	double commands_per_second = 0.0;
+	double p50_microseconds = 0.0;
+	double p99_microseconds = 0.0;
+};
+
+// Hammers a ConsoleServer with the same command from several clients and measures throughput and latency
+// Each client keeps up to pipeline_depth commands in flight, latency is from sending a command to reading its response
+// The server has to be polled from another thread (or process) while this runs
+class ConsoleLoadGenerator
+{
+public:
+	struct Config
+	{
+		std::string command = "echo load";
+		size_t clients = 8;
+		size_t commands_per_client = 10000;
+		size_t pipeline_depth = 16;
+	};
+public:
+	static ConsoleLoadResult run(const std::string& path, const Config& config)
+	{
+		ConsoleLoadResult result;
+
+		std::vector<int> sockets;
+		for (size_t i = 0; i < config.clients; i++)
+		{
+			int fd = connect_to(path);
+			if (fd < 0)
+			{
+				for (int s : sockets)
+					::close(s);
+				return result;
+			}
+			sockets.push_back(fd);
+		}
+		result.connected = true;
+
+		std::vector<std::vector<float>> latencies(config.clients);
+		std::vector<size_t> errors(config.clients, 0);
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < config.clients; i++)
+			threads.emplace_back([&, i]() { run_client(sockets[i], config, latencies[i], errors[i]); });
+		for (std::thread& thread : threads)
+			thread.join();
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for (int s : sockets)
+			::close(s);
+
+		std::vector<float> all;
+		for (size_t i = 0; i < config.clients; i++)
+		{
+			all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+			result.errors += errors[i];
+		}
+
+		result.commands = all.size();
+		if (result.seconds > 0.0)
+			result.commands_per_second = result.commands / result.seconds;
+		result.p50_microseconds = percentile(all, 0.50);
+		result.p99_microseconds = percentile(all, 0.99);
+		return result;
+	}
+private:
+	static int connect_to(const std::string& path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			return -1;
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return -1;
+
+		if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	static void run_client(int fd, const Config& config, std::vector<float>& latencies, size_t& errors)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		std::string line = config.command + '\n';
+		size_t depth = std::max<size_t>(config.pipeline_depth, 1);
+		std::vector<Clock::time_point> sent_at(depth); // ring, responses arrive in the order commands were sent
+		latencies.reserve(config.commands_per_client);
+
+		std::string batch;
+		std::string input;
+		char buffer[16 * 1024];
+
+		size_t sent = 0, received = 0;
+		while (received < config.commands_per_client)
+		{
+			// Top the pipeline up with a single write
+			batch.clear();
+			Clock::time_point now = Clock::now();
+			while (sent < config.commands_per_client && sent - received < depth)
+			{
+				batch += line;
+				sent_at[sent % depth] = now;
+				sent++;
+			}
+			if (!batch.empty() && !send_all(fd, batch))
+				return;
+
+			ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+			if (count <= 0)
+				return; // server went away
+			input.append(buffer, count);
+
+			Clock::time_point arrived = Clock::now();
+			size_t position = 0;
+			size_t newline;
+			while ((newline = input.find('\n', position)) != std::string::npos)
+			{
+				// Output of the command, its response is still to come
+				if (input.compare(position, 2, "> ") == 0)
+				{
+					position = newline + 1;
+					continue;
+				}
+
+				if (input.compare(position, newline - position, "ok") != 0)
+					errors++;
+
+				latencies.push_back(std::chrono::duration<float, std::micro>(arrived - sent_at[received % depth]).count());
+				received++;
+				position = newline + 1;
+			}
+			input.erase(0, position);
+		}
+	}
+
+	static bool send_all(int fd, const std::string& data)
+	{
+		size_t offset = 0;
+		while (offset < data.size())
+		{
+			ssize_t sent = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			if (sent <= 0)
+				return false;
+			offset += sent;
+		}
+		return true;
+	}
+
+	static double percentile(std::vector<float>& values, double p)
+	{
+		if (values.empty())
+			return 0.0;
+
+		size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+};
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+// A free function, or a member function bound to an instance, callable with a fixed signature
+// The target is picked at compile time where possible, so calling is one indirect call into a stub that calls the target directly
+// Never allocates, and two delegates compare equal when they call the same target (on the same instance), so they can be found and removed from lists
+//
+// Delegate<void(int)> d = Delegate<void(int)>::bind<&Player::on_damage>(player);
+// Delegate<void(int)> f = Delegate<void(int)>::bind<&log_damage>();
+template<typename Signature>
+class Delegate;
+
+template<typename R, typename... Args>
+class Delegate<R(Args...)>
+{
+private:
+	union Target
+	{
+		void* instance;
+		R(*function)(Args...);
+	};
+	using Stub = R(*)(Target target, Args&&... args);
+
+	Target m_Target;
+	Stub m_Stub = nullptr;
+public:
+	Delegate()
+	{
+		memset(&m_Target, 0, sizeof(m_Target));
+	}
+
+	// Bound to a function pointer only known at runtime
+	Delegate(R(*function)(Args...))
+		: Delegate()
+	{
+		m_Target.function = function;
+		m_Stub = &function_stub;
+	}
+
+	// Bound to instance.*Method, instance must outlive the delegate
+	template<auto Method, typename T>
+	static Delegate bind(T& instance)
+	{
+		static_assert(std::is_member_function_pointer_v<decltype(Method)>, "bind<Method>(instance) expects a member function");
+
+		Delegate delegate;
+		delegate.m_Target.instance = const_cast<void*>(static_cast<const void*>(&instance));
+		delegate.m_Stub = [](Target target, Args&&... args) -> R {
+			return std::invoke(Method, *static_cast<T*>(target.instance), std::forward<Args>(args)...);
+		};
+		return delegate;
+	}
+
+	// Bound to a free function known at compile time
+	template<auto Function>
+	static Delegate bind()
+	{
+		Delegate delegate;
+		delegate.m_Stub = [](Target, Args&&... args) -> R {
+			return std::invoke(Function, std::forward<Args>(args)...);
+		};
+		return delegate;
+	}
+
+	R operator()(Args... args) const
+	{
+		return m_Stub(m_Target, std::forward<Args>(args)...);
+	}
+
+	bool operator==(const Delegate& other) const
+	{
+		return m_Stub == other.m_Stub && memcmp(&m_Target, &other.m_Target, sizeof(Target)) == 0;
+	}
+	bool operator!=(const Delegate& other) const
+	{
+		return !(*this == other);
+	}
+
+	operator bool() const { return m_Stub; }
+
+	// The instance a member function is bound to, nullptr for free functions
+	void* instance() const { return m_Stub != &function_stub ? m_Target.instance : nullptr; }
+private:
+	static R function_stub(Target target, Args&&... args)
+	{
+		return target.function(std::forward<Args>(args)...);
+	}
+};
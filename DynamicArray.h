@@ -1,75 +1,220 @@
 #pragma once
 
 #include "Iterator.h"
+#include "Allocator.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+
+// Whether a T can be moved to a new address with a plain memcpy (and the old bytes simply forgotten)
+// True for trivially copyable types, specialize to opt in other types (ie. ones that only hold a heap pointer)
+template<typename T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template<typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+// Uninitialized storage for N elements living inside the DynamicArray itself
+template<typename T, size_t N>
+struct DynamicArrayInlineStorage
+{
+	alignas(T) uint8_t m_Inline[N * sizeof(T)];
+
+	T* inline_data() { return reinterpret_cast<T*>(m_Inline); }
+	const T* inline_data() const { return reinterpret_cast<const T*>(m_Inline); }
+};
+template<typename T>
+struct DynamicArrayInlineStorage<T, 0>
+{
+	T* inline_data() { return nullptr; }
+	const T* inline_data() const { return nullptr; }
+};
 
 // simple dynamically-resizing array
 // make sure to use proper indices, cause it doesn't really bounds-check
-template<typename T>
-class DynamicArray
+// storage comes from the IAllocator passed on construction (global heap by default)
+// with N > 0 the first N elements are stored inline and the allocator is only touched once the array grows past N
+template<typename T, size_t N = 0>
+class DynamicArray : private DynamicArrayInlineStorage<T, N>
 {
 public:
-	using Iterator = ContiguousIterator<T>;
+	using Iterator = ::Iterator<T>;
+
+	static constexpr size_t npos = ~size_t(0);
 public:
-	DynamicArray(size_t capacity = 2)
+	DynamicArray(size_t capacity = 2, IAllocator* allocator = &HeapAllocator::get())
+		: m_Allocator(allocator)
 	{
-		reallocate(capacity);
+		initialize(capacity);
 	}
-	DynamicArray(std::initializer_list<T> elements)
+	DynamicArray(std::initializer_list<T> elements, IAllocator* allocator = &HeapAllocator::get())
+		: m_Allocator(allocator)
 	{
-		reallocate(elements.size());
+		initialize(elements.size());
 		for (const T& t : elements)
 			add(t);
 	}
+	// The copy uses the allocator other's allocator picks for copies, usually the same one (see IAllocator::select_for_copy)
 	DynamicArray(const DynamicArray& other)
+		: m_Allocator(other.m_Allocator->select_for_copy())
 	{
-		reallocate(other.size());
+		initialize(other.size());
 		for (const T& t : other)
 			add(t);
 	}
 	~DynamicArray()
 	{
 		clear();
-		::operator delete(m_Data, m_Capacity * sizeof(T));
+		if (!is_inline())
+			m_Allocator->deallocate(m_Data, m_Capacity * sizeof(T), alignof(T));
 	}
 
 	void add(const T& element)
 	{
-		if (m_Size >= m_Capacity)
-			reallocate(m_Capacity + m_Capacity / 2);
-
+		grow(m_Size + 1);
 		new (m_Data + m_Size++) T(element);
 	}
 	void add(T&& element)
 	{
-		if (m_Size >= m_Capacity)
-			reallocate(m_Capacity + m_Capacity / 2);
-
+		grow(m_Size + 1);
 		new (m_Data + m_Size++) T(std::move(element));
 	}
 
 	template<typename... Args>
 	T& emplace(Args&&... args)
 	{
-		if (m_Size >= m_Capacity)
-			reallocate(m_Capacity + m_Capacity / 2);
-
+		grow(m_Size + 1);
 		new(m_Data + m_Size) T(std::forward<Args>(args)...);
 		return m_Data[m_Size++];
 	}	
 
-	void remove(size_t index)
+	// Copies count elements to the end of the array, growing at most once
+	void append(const T* elements, size_t count)
 	{
-		m_Data[index].~T();
-		m_Size--;
+		insert(m_Size, elements, elements + count);
+	}
+	template<typename It>
+	void append(It first, It last)
+	{
+		insert(m_Size, first, last);
+	}
+	// Appends every element of a container/range that supports begin() and end()
+	template<typename Range>
+	void append(const Range& range)
+	{
+		append(std::begin(range), std::end(range));
+	}
+
+	// Copies [first, last) in front of the element at index, growing at most once
+	template<typename It>
+	void insert(size_t index, It first, It last)
+	{
+		size_t count = 0;
+		if constexpr (requires { size_t(last - first); })
+			count = size_t(last - first);
+		else
+			for (It it = first; it != last; ++it) count++;
 
-		for (size_t i = index; i < m_Size; i++)
-			new(m_Data + i) T(std::move(m_Data[i + 1]));
+		if (!count)
+			return;
+
+		// The elements are about to move (the gap, or growing), copy them out first when they're our own
+		if (aliases(first))
+		{
+			DynamicArray<T> copy(count);
+			copy.append(first, last);
+			insert(index, copy.data(), copy.data() + count);
+			return;
+		}
+
+		grow(m_Size + count);
+
+		// Open a gap of count elements at index
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			memmove((void*)(m_Data + index + count), m_Data + index, (m_Size - index) * sizeof(T));
+		}
+		else
+		{
+			// Back to front so every destination is either past the end or already moved out of
+			for (size_t i = m_Size; i > index; i--)
+			{
+				new (m_Data + i - 1 + count) T(std::move(m_Data[i - 1]));
+				m_Data[i - 1].~T();
+			}
+		}
+
+		// Only a straight byte copy when the source holds T's as well (not, say, int32_t's into a DynamicArray<int64_t>)
+		if constexpr (std::is_pointer_v<It> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<It>>, T> && std::is_trivially_copyable_v<T>)
+		{
+			memcpy((void*)(m_Data + index), first, count * sizeof(T));
+		}
+		else
+		{
+			T* destination = m_Data + index;
+			for (It it = first; it != last; ++it)
+				new (destination++) T(*it);
+		}
+
+		m_Size += count;
+	}
+	template<typename It>
+	void insert(Iterator pos, It first, It last)
+	{
+		size_t index = pos - Iterator(m_Data);
+		insert(index, first, last);
+	}
+
+	// Keeps the order of the remaining elements, O(n)
+	void remove(size_t index)
+	{
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			m_Data[index].~T();
+			m_Size--;
+			memmove((void*)(m_Data + index), m_Data + index + 1, (m_Size - index) * sizeof(T));
+		}
+		else
+		{
+			m_Size--;
+			for (size_t i = index; i < m_Size; i++)
+				m_Data[i] = std::move(m_Data[i + 1]);
+			m_Data[m_Size].~T();
+		}
 	}
 	void remove(Iterator it)
 	{
 		size_t index = it - Iterator(m_Data);
 		remove(index);
 	}
+	// Moves the last element into the removed slot, O(1) but doesn't keep order
+	void swap_remove(size_t index)
+	{
+		m_Size--;
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			m_Data[index].~T();
+			if (index != m_Size)
+				memcpy((void*)(m_Data + index), m_Data + m_Size, sizeof(T));
+		}
+		else
+		{
+			if (index != m_Size)
+				m_Data[index] = std::move(m_Data[m_Size]);
+			m_Data[m_Size].~T();
+		}
+	}
+	void swap_remove(Iterator it)
+	{
+		size_t index = it - Iterator(m_Data);
+		swap_remove(index);
+	}
 	void remove_last()
 	{
 		if (m_Size <= 0)
@@ -79,6 +224,30 @@ public:
 		m_Data[m_Size].~T();
 	}
 
+	// Removes every element the predicate returns true for in a single pass, keeps the order of the rest
+	// Returns the number of elements removed
+	template<typename F>
+	size_t erase_if(F predicate)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < m_Size; i++)
+		{
+			if (predicate(m_Data[i]))
+				continue;
+
+			if (kept != i)
+				m_Data[kept] = std::move(m_Data[i]);
+			kept++;
+		}
+
+		size_t removed = m_Size - kept;
+		for (size_t i = kept; i < m_Size; i++)
+			m_Data[i].~T();
+		m_Size = kept;
+
+		return removed;
+	}
+
 	void clear()
 	{
 		for (size_t i = 0; i < m_Size; i++)
@@ -86,46 +255,85 @@ public:
 		m_Size = 0;
 	}
 	
+	// find/contains/index_of/count are vectorized for arithmetic T (see Simd.h)
 	Iterator find(const T& element) const
 	{
-		return std::find(begin(), end(), element);
+		return { m_Data + find_index(element) };
 	}
 
 	bool contains(const T& element) const
 	{
-		return find(element) != end();
+		return find_index(element) != m_Size;
 	}
 
-	int32_t index_of(const T& element) const
+	// Returns npos if the element isn't in the array
+	size_t index_of(const T& element) const
 	{
-		int32_t index = 0;
-		for (Iterator it = begin(); it != end(); it++)
-		{
-			if (*it == element)
-				return index;
-			index++;
-		}
+		size_t index = find_index(element);
+		return index == m_Size ? npos : index;
+	}
+
+	// Number of elements equal to element
+	size_t count(const T& element) const
+	{
+		if constexpr (is_simd_searchable_v<T>)
+			return simd_count(m_Data, m_Size, element);
+		else
+			return std::count(m_Data, m_Data + m_Size, element);
+	}
 
-		return -1;
+	// Iterator to the first element the predicate returns true for, or end()
+	template<typename F>
+	Iterator find_if(F predicate) const
+	{
+		return { std::find_if(m_Data, m_Data + m_Size, predicate) };
+	}
+
+	template<typename F>
+	size_t count_if(F predicate) const
+	{
+		return std::count_if(m_Data, m_Data + m_Size, predicate);
 	}
 
 	void reserve(size_t capacity)
 	{
-		if (capacity < m_Capacity)
+		if (capacity <= m_Capacity)
 			return;
 
 		reallocate(capacity);
 	}
 
-	void resize(size_t capacity)
+	// Sets the number of elements, new elements are value-initialized (zeroed for trivial types)
+	void resize(size_t size)
 	{
-		m_Capacity = capacity;
-		reserve(m_Capacity);
-
-		for (size_t i = m_Size; i < m_Capacity; i++)
-		{
+		reserve(size);
+		for (size_t i = size; i < m_Size; i++)
+			m_Data[i].~T();
+		for (size_t i = m_Size; i < size; i++)
 			new(m_Data + i) T();
-		}
+
+		m_Size = size;
+	}
+
+	// Same as resize(), but new elements are default-initialized (left with garbage for trivial types)
+	void resize_default_init(size_t size)
+	{
+		reserve(size);
+		for (size_t i = size; i < m_Size; i++)
+			m_Data[i].~T();
+		for (size_t i = m_Size; i < size; i++)
+			new(m_Data + i) T;
+
+		m_Size = size;
+	}
+
+	// Sets the number of elements without touching the memory at all, the caller is expected to fill them in (ie. from a file read)
+	void resize_uninitialized(size_t size)
+	{
+		static_assert(std::is_trivial_v<T>, "resize_uninitialized() requires a trivial T");
+
+		reserve(size);
+		m_Size = size;
 	}
 
 	// shrink capacity to size (reallocates)
@@ -148,35 +356,119 @@ public:
 
 	T& last() { return operator[](m_Size - 1); }
 
+	T* data() { return m_Data; }
+	const T* data() const { return m_Data; }
+
 	size_t size() const { return m_Size; }
 	size_t capacity() const { return m_Capacity; }
+	IAllocator* allocator() const { return m_Allocator; }
+	// Whether the elements currently live in the inline buffer
+	bool is_inline() const { return N > 0 && m_Data == inline_data(); }
 
 	Iterator begin() const { return { m_Data }; }
 	Iterator end()   const { return { m_Data + m_Size }; }
 private:
+	using DynamicArrayInlineStorage<T, N>::inline_data;
+
+	void initialize(size_t capacity)
+	{
+		m_Data = inline_data();
+		m_Capacity = N;
+
+		if (capacity > N || !m_Data)
+			reallocate(capacity);
+	}
+
+	// Makes room for at least required elements, growing by 1.5x unless more than that is needed
+	void grow(size_t required)
+	{
+		if (required <= m_Capacity)
+			return;
+
+		size_t newCapacity = m_Capacity + m_Capacity / 2;
+		reallocate(newCapacity < required ? required : newCapacity);
+	}
+
 	void reallocate(size_t newCapacity)
 	{
 		if (!m_Data)
 		{
 			m_Capacity = newCapacity;
-			m_Data = (T*)::operator new(m_Capacity * sizeof(T));
+			m_Data = (T*)m_Allocator->allocate(m_Capacity * sizeof(T), alignof(T));
 			return;
 		}
 
+		// Elements that don't fit anymore are destroyed
+		for (size_t i = newCapacity; i < m_Size; i++)
+			m_Data[i].~T();
 		m_Size = newCapacity < m_Size ? newCapacity : m_Size;
 
-		T* newData = (T*)::operator new(newCapacity * sizeof(T));
-		for (size_t i = 0; i < m_Size; i++)
+		// The inline buffer is always there, so never go below it
+		bool toInline = newCapacity <= N;
+		if (toInline)
+		{
+			newCapacity = N;
+			if (is_inline())
+				return;
+		}
+
+		// Some allocators can extend the existing block, nothing has to move then
+		if (!toInline && !is_inline() && m_Allocator->resize_in_place(m_Data, m_Capacity * sizeof(T), newCapacity * sizeof(T)))
 		{
-			new (newData + i) T(std::move(m_Data[i]));
+			m_Capacity = newCapacity;
+			return;
 		}
 
-		::operator delete(m_Data, m_Capacity * sizeof(T));
+		T* newData = toInline ? inline_data() : (T*)m_Allocator->allocate(newCapacity * sizeof(T), alignof(T));
+		relocate(newData, m_Data, m_Size);
+
+		if (!is_inline())
+			m_Allocator->deallocate(m_Data, m_Capacity * sizeof(T), alignof(T));
 		m_Data = newData;
 		m_Capacity = newCapacity;
 	}
+
+	// Whether an iterator passed to insert() points at one of this array's elements
+	template<typename It>
+	bool aliases(It first) const
+	{
+		if constexpr (std::is_same_v<std::remove_cv_t<std::remove_pointer_t<It>>, T> || std::is_same_v<It, Iterator> || std::is_same_v<It, ::Iterator<const T>>)
+		{
+			const T* element = &*first;
+			return std::less_equal<const T*>()(m_Data, element) && std::less<const T*>()(element, m_Data + m_Size);
+		}
+		else
+			return false;
+	}
+
+	size_t find_index(const T& element) const
+	{
+		if constexpr (is_simd_searchable_v<T>)
+			return simd_find(m_Data, m_Size, element);
+		else
+			return std::find(m_Data, m_Data + m_Size, element) - m_Data;
+	}
+
+	// Moves count elements from src into uninitialized dst, the elements in src are left destroyed
+	static void relocate(T* dst, T* src, size_t count)
+	{
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			if (count)
+				memcpy((void*)dst, src, count * sizeof(T));
+		}
+		else
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				new (dst + i) T(std::move(src[i]));
+				src[i].~T();
+			}
+		}
+	}
 private:
 	size_t m_Size = 0;
 	size_t m_Capacity = 0;
 	T* m_Data = nullptr;
+	IAllocator* m_Allocator = nullptr;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Bitset.h"
+#include "Function.h"
 
 using Entity = uint32_t;
 
@@ -133,6 +134,17 @@ public:
 		}
 	}
 
+	// Calls func(Entity) for every active entity
+	// Takes a function_ref rather than a template parameter so callers can pass it through non-template code without any allocation
+	void for_each_entity(function_ref<void(Entity)> func) const
+	{
+		for (uint32_t i = 0; i < entities_availability.count(); i++)
+		{
+			if (entities_availability[i])
+				func(i + 1);
+		}
+	}
+
 	uint32_t get_entity_count() const { return entity_count; }
 private:
 	uint32_t ComponentIt = 0;
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "Bitset.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Most threads that can read through an EpochDomain at the same time
+static constexpr size_t EpochMaxThreads = 128;
+
+// Epoch based reclamation: lets writers free memory that lock-free readers might still be looking at, once they're done with it
+// Readers announce the global epoch they started in and clear it when they leave, both are a store to a cache line only that thread writes,
+// so reading never takes a lock and threads never contend with each other
+// Writers retire() memory instead of deleting it, it's freed once the global epoch has moved two steps past the retire,
+// which can only happen after every reader that could have seen it has left
+class EpochDomain
+{
+private:
+	static constexpr uint64_t Inactive = 0;
+
+	// One per thread, padded so announcing never invalidates another reader's cache line
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> epoch = Inactive;
+		uint32_t depth = 0; // nested guards, only touched by the owning thread
+	};
+
+	struct Retired
+	{
+		void* memory;
+		void(*deleter)(void*);
+		uint64_t epoch;
+	};
+public:
+	// Marks the calling thread as reading for as long as it lives, guards can nest
+	class Guard
+	{
+	public:
+		Guard(EpochDomain& domain)
+			: m_Domain(domain)
+		{
+			m_Domain.enter();
+		}
+		~Guard()
+		{
+			m_Domain.leave();
+		}
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+	private:
+		EpochDomain& m_Domain;
+	};
+public:
+	EpochDomain() = default;
+	~EpochDomain()
+	{
+		// No readers are left by now
+		for (Retired& retired : m_Retired)
+			retired.deleter(retired.memory);
+	}
+
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+
+	// Shared by everything that doesn't need its own domain
+	static EpochDomain& global()
+	{
+		static EpochDomain domain;
+		return domain;
+	}
+
+	// Deletes memory once no reader can be using it anymore, can be called from any thread
+	template<typename T>
+	void retire(T* memory)
+	{
+		if (!memory)
+			return;
+
+		std::lock_guard lock(m_WriterLock);
+		m_Retired.push_back({ memory, [](void* p) { delete static_cast<T*>(p); }, m_GlobalEpoch.load(std::memory_order_seq_cst) });
+		reclaim_locked();
+	}
+
+	// Frees whatever retired memory is safe to free, returns how much is still waiting
+	size_t reclaim()
+	{
+		std::lock_guard lock(m_WriterLock);
+		reclaim_locked();
+		return m_Retired.size();
+	}
+
+	// Waits until everything retired so far has been freed, spins while readers are still inside a guard
+	// Don't call from inside a guard, the calling thread would be waiting on itself
+	void synchronize()
+	{
+		while (reclaim() != 0)
+			std::this_thread::yield();
+	}
+
+	size_t retired_count()
+	{
+		std::lock_guard lock(m_WriterLock);
+		return m_Retired.size();
+	}
+private:
+	void enter()
+	{
+		Slot& slot = m_Slots[thread_index()];
+		if (slot.depth++ != 0)
+			return;
+
+		// The epoch we announce has to still be the current one once the announcement is visible,
+		// otherwise a writer could have advanced past it without seeing us
+		uint64_t epoch = m_GlobalEpoch.load(std::memory_order_relaxed);
+		while (true)
+		{
+			slot.epoch.store(epoch, std::memory_order_seq_cst);
+
+			uint64_t current = m_GlobalEpoch.load(std::memory_order_seq_cst);
+			if (current == epoch)
+				return;
+			epoch = current;
+		}
+	}
+
+	void leave()
+	{
+		Slot& slot = m_Slots[thread_index()];
+		if (--slot.depth == 0)
+			slot.epoch.store(Inactive, std::memory_order_release);
+	}
+
+	// Expects m_WriterLock to be held
+	void reclaim_locked()
+	{
+		try_advance();
+
+		uint64_t epoch = m_GlobalEpoch.load(std::memory_order_relaxed);
+		size_t kept = 0;
+		for (size_t i = 0; i < m_Retired.size(); i++)
+		{
+			// Readers that started in the retire epoch all left before the epoch could move to retire + 2
+			if (m_Retired[i].epoch + 2 <= epoch)
+				m_Retired[i].deleter(m_Retired[i].memory);
+			else
+				m_Retired[kept++] = m_Retired[i];
+		}
+		m_Retired.resize(kept);
+	}
+
+	// Moves the global epoch forward if every active reader has caught up with it
+	// Tried twice, memory retired just now can be freed straight away if nobody is reading
+	void try_advance()
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			uint64_t epoch = m_GlobalEpoch.load(std::memory_order_seq_cst);
+			for (const Slot& slot : m_Slots)
+			{
+				uint64_t announced = slot.epoch.load(std::memory_order_seq_cst);
+				if (announced != Inactive && announced != epoch)
+					return;
+			}
+
+			m_GlobalEpoch.store(epoch + 1, std::memory_order_seq_cst);
+		}
+	}
+
+	// Index of the calling thread, claimed the first time it's needed and given back when the thread exits
+	static size_t thread_index()
+	{
+		struct Registration
+		{
+			size_t index;
+
+			Registration()
+				: index(thread_ids().claim_first_unset())
+			{
+				ASSERT(index != AtomicBitset<EpochMaxThreads>::npos && "more than EpochMaxThreads threads reading");
+			}
+			~Registration()
+			{
+				thread_ids().reset(index);
+			}
+		};
+
+		thread_local Registration registration;
+		return registration.index;
+	}
+
+	static AtomicBitset<EpochMaxThreads>& thread_ids()
+	{
+		static AtomicBitset<EpochMaxThreads> ids;
+		return ids;
+	}
+private:
+	Slot m_Slots[EpochMaxThreads];
+	alignas(64) std::atomic<uint64_t> m_GlobalEpoch = 1;
+
+	std::mutex m_WriterLock; // writers only, readers never touch it
+	std::vector<Retired> m_Retired;
+};
+
+// Pointer to read-mostly data that any number of threads read while writers swap in new versions (read-copy-update)
+// Reading is entering an epoch and one atomic load, there's no reference count for readers to fight over
+// publish() swaps the pointer and retires the old version, which is deleted once every reader that might see it is done
+//
+// rcu_ptr<Config> config(new Config());
+// { auto read = config.read(); use(read->value); }  // read stays valid until it goes out of scope
+// config.publish(new Config(updated));
+template<typename T>
+class rcu_ptr
+{
+public:
+	// A version of the data, kept alive for as long as the guard lives
+	class ReadGuard
+	{
+	public:
+		ReadGuard(EpochDomain& domain, const std::atomic<T*>& ptr)
+			: m_Guard(domain), m_Ptr(ptr.load(std::memory_order_acquire))
+		{
+		}
+
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+
+		const T* get() const { return m_Ptr; }
+		const T& operator*() const { return *m_Ptr; }
+		const T* operator->() const { return m_Ptr; }
+
+		operator bool() const { return m_Ptr; }
+	private:
+		EpochDomain::Guard m_Guard;
+		const T* m_Ptr;
+	};
+public:
+	rcu_ptr(T* initial = nullptr, EpochDomain& domain = EpochDomain::global())
+		: m_Ptr(initial), m_Domain(domain)
+	{
+	}
+	~rcu_ptr()
+	{
+		m_Domain.retire(m_Ptr.load(std::memory_order_relaxed));
+	}
+
+	rcu_ptr(const rcu_ptr&) = delete;
+	rcu_ptr& operator=(const rcu_ptr&) = delete;
+
+	ReadGuard read() const
+	{
+		return ReadGuard(m_Domain, m_Ptr);
+	}
+
+	// Takes ownership of value and makes it visible to every read() from now on
+	void publish(T* value)
+	{
+		m_Domain.retire(m_Ptr.exchange(value, std::memory_order_acq_rel));
+	}
+
+	// Publishes value only if the current version is still expected, for writers racing each other
+	// Takes ownership of value only when it returns true
+	bool compare_and_publish(const T* expected, T* value)
+	{
+		T* current = const_cast<T*>(expected);
+		if (!m_Ptr.compare_exchange_strong(current, value, std::memory_order_acq_rel, std::memory_order_acquire))
+			return false;
+
+		m_Domain.retire(current);
+		return true;
+	}
+
+	EpochDomain& domain() const { return m_Domain; }
+private:
+	std::atomic<T*> m_Ptr;
+	EpochDomain& m_Domain;
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "Delegate.h"
+#include "DynamicArray.h"
+
+#include <memory>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+// Handle returned by Signal::connect(), used to disconnect that listener again in O(1)
+struct Connection
+{
+	uint32_t id = ~0u;
+	uint32_t generation = 0;
+
+	bool valid() const { return id != ~0u; }
+};
+
+// Calls every connected listener when emitted
+// Listeners are Delegates stored contiguously, emitting is a linear walk with one direct call per listener
+// Connecting or disconnecting from inside a listener is fine: new listeners are first called on the next emit(),
+// disconnected ones are skipped immediately and removed once the outermost emit() returns
+// Listener order isn't kept when something disconnects
+template<typename... Args>
+class Signal
+{
+public:
+	using Listener = Delegate<void(Args...)>;
+public:
+	Connection connect(Listener listener)
+	{
+		uint32_t id;
+		if (m_FreeIds.size())
+		{
+			id = m_FreeIds.last();
+			m_FreeIds.remove_last();
+		}
+		else
+		{
+			id = static_cast<uint32_t>(m_Slots.size());
+			m_Slots.add({});
+		}
+
+		m_Slots[id].index = static_cast<uint32_t>(m_Listeners.size());
+		m_Listeners.add(listener);
+		m_ListenerIds.add(id);
+
+		return { id, m_Slots[id].generation };
+	}
+
+	// Convenience for connect(Listener::bind<Method>(instance))
+	template<auto Method, typename T>
+	Connection connect(T& instance)
+	{
+		return connect(Listener::template bind<Method>(instance));
+	}
+
+	void disconnect(Connection connection)
+	{
+		if (!connection.valid() || connection.id >= m_Slots.size() || m_Slots[connection.id].generation != connection.generation)
+			return; // already disconnected
+
+		remove_at(m_Slots[connection.id].index);
+	}
+
+	// Disconnects the first listener equal to the given one, O(n)
+	void disconnect(const Listener& listener)
+	{
+		size_t index = m_Listeners.index_of(listener);
+		if (index != m_Listeners.npos)
+			remove_at(index);
+	}
+
+	void emit(Args... args)
+	{
+		m_Dispatching++;
+
+		// Listeners connected from inside a listener land past count
+		size_t count = m_Listeners.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			// Copied out, a listener connecting another one could reallocate the array under us
+			Listener listener = m_Listeners[i];
+			if (listener)
+				listener(args...);
+		}
+
+		if (--m_Dispatching == 0 && m_PendingRemovals)
+			compact();
+	}
+
+	void clear()
+	{
+		for (size_t i = m_Listeners.size(); i > 0; i--)
+			remove_at(i - 1);
+	}
+
+	size_t size() const { return m_Listeners.size() - m_PendingRemovals; }
+	bool empty() const { return size() == 0; }
+private:
+	struct Slot
+	{
+		uint32_t index = 0; // into m_Listeners
+		uint32_t generation = 0;
+	};
+
+	void remove_at(size_t index)
+	{
+		uint32_t id = m_ListenerIds[index];
+		if (m_Dispatching)
+		{
+			// Can't move listeners around while emit() is walking them, leave a hole to clean up later
+			if (m_Listeners[index])
+			{
+				m_Listeners[index] = Listener();
+				m_PendingRemovals++;
+			}
+			return;
+		}
+
+		m_Listeners.swap_remove(index);
+		m_ListenerIds.swap_remove(index);
+		if (index < m_Listeners.size())
+			m_Slots[m_ListenerIds[index]].index = static_cast<uint32_t>(index);
+
+		m_Slots[id].generation++;
+		m_FreeIds.add(id);
+	}
+
+	// Drops the holes left by disconnects during emit()
+	void compact()
+	{
+		for (size_t i = m_Listeners.size(); i > 0; i--)
+		{
+			if (m_Listeners[i - 1])
+				continue;
+
+			// Removed by swapping in the last listener, which has already been looked at
+			uint32_t id = m_ListenerIds[i - 1];
+			m_Listeners.swap_remove(i - 1);
+			m_ListenerIds.swap_remove(i - 1);
+			if (i - 1 < m_Listeners.size())
+				m_Slots[m_ListenerIds[i - 1]].index = static_cast<uint32_t>(i - 1);
+
+			m_Slots[id].generation++;
+			m_FreeIds.add(id);
+		}
+		m_PendingRemovals = 0;
+	}
+private:
+	DynamicArray<Listener> m_Listeners;
+	DynamicArray<uint32_t> m_ListenerIds; // id of each listener, parallel to m_Listeners
+	DynamicArray<Slot> m_Slots;           // indexed by id
+	DynamicArray<uint32_t> m_FreeIds;
+	size_t m_PendingRemovals = 0;
+	uint32_t m_Dispatching = 0;
+};
+
+// Queues events by type and hands them to listeners in batches
+// enqueue<E>() only appends to E's queue, dispatch() then calls every listener of E once with the whole array of queued Es,
+// so a listener processes events in a loop instead of being called once per event
+// Events enqueued while dispatching are delivered on the next dispatch()
+class EventDispatcher
+{
+private:
+	struct IEventQueue
+	{
+		virtual ~IEventQueue() = default;
+		virtual void dispatch() = 0;
+	};
+
+	template<typename E>
+	struct EventQueue : IEventQueue
+	{
+		std::vector<E> events;
+		std::vector<E> spare; // capacity of the last batch, reused by the next one
+		Signal<const E*, size_t> signal;
+
+		void dispatch() override
+		{
+			if (events.empty())
+				return;
+
+			// The batch is moved into a local so listeners can enqueue more events, or even dispatch() again,
+			// without touching the array they were given
+			std::vector<E> batch = std::move(spare);
+			batch.clear();
+			std::swap(batch, events);
+
+			signal.emit(batch.data(), batch.size());
+
+			batch.clear();
+			if (batch.capacity() > spare.capacity())
+				spare = std::move(batch);
+		}
+	};
+
+	std::unordered_map<size_t, std::unique_ptr<IEventQueue>> m_Queues; // [hash, queue]
+	DynamicArray<IEventQueue*> m_DispatchOrder;
+public:
+	EventDispatcher() = default;
+	EventDispatcher(const EventDispatcher&) = delete;
+	EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+	// Listeners of E are called as void(const E* events, size_t count)
+	template<typename E>
+	Signal<const E*, size_t>& sink()
+	{
+		return get_or_create_queue<E>().signal;
+	}
+
+	template<typename E>
+	void enqueue(E event)
+	{
+		get_or_create_queue<E>().events.push_back(std::move(event));
+	}
+
+	// Skips the queue and calls E's listeners right away
+	template<typename E>
+	void trigger(const E& event)
+	{
+		get_or_create_queue<E>().signal.emit(&event, 1);
+	}
+
+	// Delivers every queued event, one batch per event type (in the order the types were first used)
+	// Listeners may enqueue events or call dispatch() themselves, a nested dispatch() delivers whatever was queued up to then
+	void dispatch()
+	{
+		// By index, a listener using a new event type adds a queue
+		for (size_t i = 0; i < m_DispatchOrder.size(); i++)
+			m_DispatchOrder[i]->dispatch();
+	}
+private:
+	template<typename E>
+	EventQueue<E>& get_or_create_queue()
+	{
+		static size_t hash = typeid(E).hash_code();
+
+		auto it = m_Queues.find(hash);
+		if (it == m_Queues.end())
+		{
+			it = m_Queues.emplace(hash, std::make_unique<EventQueue<E>>()).first;
+			m_DispatchOrder.add(it->second.get());
+		}
+
+		return static_cast<EventQueue<E>&>(*it->second);
+	}
+};
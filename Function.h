@@ -3,6 +3,9 @@
 #include <algorithm>
 #include <type_traits>
 #include <memory>
+#include <cstddef>
+#include <cstring>
+#include <functional>
 
 template<size_t N, typename... Ts> using TypeOfNth =
 typename std::tuple_element<N, std::tuple<Ts...>>::type;
@@ -76,6 +79,7 @@ private:
 	{
 		virtual ~ILambda() {}
 		virtual void invoke_erased(void* return_value, void* erased_tuple_args) = 0;
+		virtual ILambda* clone() const = 0;
 	};
 
 	template<typename F>
@@ -87,6 +91,11 @@ private:
 			: lambda(lambda)
 		{}
 
+		ILambda* clone() const override
+		{
+			return new LambdaImpl(lambda);
+		}
+
 		// Voodoo
 		virtual void invoke_erased(void* return_value, void* erased_tuple_args) override
 		{
@@ -116,17 +125,28 @@ private:
 	void* m_FnPtr = nullptr;
 	bool m_IsLambda = false;
 public:
-	// Cant assign Function = Function yet
 	Function() = default;
 	~Function()
 	{
-		if (!m_IsLambda)
-			return;
+		reset();
+	}
+
+	// Lambdas are cloned, function pointers are copied into our own storage
+	Function(const Function& other)
+	{
+		copy_from(other);
+	}
+	Function& operator=(const Function& other)
+	{
+		if (this == &other)
+			return *this;
 
-		delete m_FnPtr;
+		reset();
+		copy_from(other);
+		return *this;
 	}
 
-	template<typename Lambda>
+	template<typename Lambda, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Lambda>, Function>>>
 	Function(Lambda l)
 	{
 		m_IsLambda = true;
@@ -146,7 +166,7 @@ public:
 		m_FnPtr = new (m_Storage) decltype(fn)(fn);
 	}
 
-	operator bool() const { return m_Storage; }
+	operator bool() const { return m_FnPtr; }
 
 	template<typename R = void, typename... Args>
 	R operator()(Args&&... args) const
@@ -186,6 +206,28 @@ public:
 		return (*function)(std::forward<Args>(args)...);
 	}
 private:
+	void reset()
+	{
+		if (m_IsLambda)
+			delete static_cast<ILambda*>(m_FnPtr);
+
+		m_FnPtr = nullptr;
+		m_IsLambda = false;
+	}
+
+	void copy_from(const Function& other)
+	{
+		m_IsLambda = other.m_IsLambda;
+		if (m_IsLambda)
+		{
+			m_FnPtr = static_cast<ILambda*>(other.m_FnPtr)->clone();
+			return;
+		}
+
+		memcpy(m_Storage, other.m_Storage, sizeof(m_Storage));
+		m_FnPtr = other.m_FnPtr ? m_Storage : nullptr;
+	}
+
 	template<typename R, typename T, typename... Args>
 	static constexpr bool is_invokable_as_method(PackT<Args...>)
 	{
@@ -215,4 +257,175 @@ private:
 			return result;
 		}
 	}
-};
\ No newline at end of file
+};
+
+// Type-erased callable with a fixed signature, ie. InplaceFunction<int(float, float)>
+// The callable (and its captures) is stored inline in Capacity bytes, so it never allocates, and too-large captures are a compile error
+// Calling it is a single indirect call, arguments are forwarded straight through
+// Member function pointers work too, taking the instance as the first argument: InplaceFunction<void(Foo&, int)> f = &Foo::bar
+template<typename Signature, size_t Capacity = 48>
+class InplaceFunction;
+
+template<typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+private:
+	using Invoker = R(*)(void* storage, Args&&... args);
+
+	// Only used for callables that aren't trivially copyable, everything else is just memcpy'd around
+	struct Operations
+	{
+		void(*copy)(void* destination, const void* source);
+		void(*move)(void* destination, void* source);
+		void(*destroy)(void* storage);
+	};
+
+	template<typename F>
+	static constexpr Operations OperationsFor = {
+		[](void* destination, const void* source) { new(destination) F(*static_cast<const F*>(source)); },
+		[](void* destination, void* source) { new(destination) F(std::move(*static_cast<F*>(source))); },
+		[](void* storage) { static_cast<F*>(storage)->~F(); },
+	};
+
+	alignas(std::max_align_t) uint8_t m_Storage[Capacity];
+	Invoker m_Invoke = nullptr;
+	const Operations* m_Operations = nullptr;
+public:
+	InplaceFunction() = default;
+	InplaceFunction(std::nullptr_t) {}
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceFunction> && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+	InplaceFunction(F&& callable)
+	{
+		using Callable = std::decay_t<F>;
+		static_assert(sizeof(Callable) <= Capacity, "callable is too big for this InplaceFunction, increase its Capacity");
+		static_assert(alignof(Callable) <= alignof(std::max_align_t), "callable is over-aligned");
+
+		new(m_Storage) Callable(std::forward<F>(callable));
+		m_Invoke = [](void* storage, Args&&... args) -> R {
+			return std::invoke(*static_cast<Callable*>(storage), std::forward<Args>(args)...);
+		};
+
+		if constexpr (!std::is_trivially_copyable_v<Callable>)
+			m_Operations = &OperationsFor<Callable>;
+	}
+
+	InplaceFunction(const InplaceFunction& other)
+	{
+		copy_from(other);
+	}
+	InplaceFunction(InplaceFunction&& other) noexcept
+	{
+		move_from(other);
+	}
+	~InplaceFunction()
+	{
+		reset();
+	}
+
+	InplaceFunction& operator=(const InplaceFunction& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			copy_from(other);
+		}
+		return *this;
+	}
+	InplaceFunction& operator=(InplaceFunction&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			move_from(other);
+		}
+		return *this;
+	}
+	InplaceFunction& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	R operator()(Args... args) const
+	{
+		return m_Invoke(const_cast<uint8_t*>(m_Storage), std::forward<Args>(args)...);
+	}
+
+	void reset()
+	{
+		if (m_Operations)
+			m_Operations->destroy(m_Storage);
+
+		m_Invoke = nullptr;
+		m_Operations = nullptr;
+	}
+
+	operator bool() const { return m_Invoke; }
+private:
+	void copy_from(const InplaceFunction& other)
+	{
+		if (other.m_Operations)
+			other.m_Operations->copy(m_Storage, other.m_Storage);
+		else if (other.m_Invoke)
+			memcpy(m_Storage, other.m_Storage, Capacity);
+
+		m_Invoke = other.m_Invoke;
+		m_Operations = other.m_Operations;
+	}
+
+	// Leaves other empty
+	void move_from(InplaceFunction& other)
+	{
+		if (other.m_Operations)
+			other.m_Operations->move(m_Storage, other.m_Storage);
+		else if (other.m_Invoke)
+			memcpy(m_Storage, other.m_Storage, Capacity);
+
+		m_Invoke = other.m_Invoke;
+		m_Operations = other.m_Operations;
+		other.reset();
+	}
+};
+
+// Non-owning reference to any callable, two pointers wide and trivially copyable, never allocates
+// Meant for passing callbacks into non-template functions, the callable must outlive the function_ref (don't store one that was bound to a temporary)
+template<typename Signature>
+class function_ref;
+
+template<typename R, typename... Args>
+class function_ref<R(Args...)>
+{
+private:
+	union Target
+	{
+		void* object;
+		R(*function)(Args...);
+	};
+	using Thunk = R(*)(Target target, Args&&... args);
+
+	Target m_Target{};
+	Thunk m_Thunk = nullptr;
+public:
+	function_ref(R(*function)(Args...))
+	{
+		m_Target.function = function;
+		m_Thunk = [](Target target, Args&&... args) -> R {
+			return target.function(std::forward<Args>(args)...);
+		};
+	}
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_ref> && !std::is_pointer_v<std::decay_t<F>> && std::is_invocable_r_v<R, F&, Args...>>>
+	function_ref(F&& callable)
+	{
+		m_Target.object = const_cast<void*>(static_cast<const void*>(std::addressof(callable)));
+		m_Thunk = [](Target target, Args&&... args) -> R {
+			return std::invoke(*static_cast<std::remove_reference_t<F>*>(target.object), std::forward<Args>(args)...);
+		};
+	}
+
+	R operator()(Args... args) const
+	{
+		return m_Thunk(m_Target, std::forward<Args>(args)...);
+	}
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 // iterator for contiguous elements
 template<typename T>
 class Iterator
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Unbounded multi-producer single-consumer queue (Vyukov's intrusive node queue)
+// push() is lock-free and costs one allocation and one atomic exchange, any number of threads can push at once
+// try_pop() must only ever be called from one thread at a time, it never blocks and never takes a lock
+// A push that is still in progress can make try_pop() report empty for a moment, the value shows up on a later call
+template<typename T>
+class MPSCQueue
+{
+private:
+	struct Node
+	{
+		std::atomic<Node*> next = nullptr;
+		alignas(T) unsigned char storage[sizeof(T)];
+
+		T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+	};
+public:
+	MPSCQueue()
+		: m_Head(&m_Stub), m_Tail(&m_Stub)
+	{
+	}
+	~MPSCQueue()
+	{
+		// Nobody is pushing anymore, destroy whatever wasn't popped
+		while (Node* next = m_Tail->next.load(std::memory_order_acquire))
+		{
+			next->value()->~T();
+			if (m_Tail != &m_Stub)
+				delete m_Tail;
+			m_Tail = next;
+		}
+
+		if (m_Tail != &m_Stub)
+			delete m_Tail;
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	// Safe from any thread
+	template<typename... Args>
+	void emplace(Args&&... args)
+	{
+		Node* node = new Node;
+		new (node->storage) T(std::forward<Args>(args)...);
+
+		// Producers serialize on the exchange, the link to the previous node is made right after
+		Node* previous = m_Head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	void push(T value)
+	{
+		emplace(std::move(value));
+	}
+
+	// Consumer thread only, returns false if nothing is queued
+	bool try_pop(T& out)
+	{
+		// m_Tail is always a node whose value has been consumed already (or the stub), the next value lives in its successor
+		Node* tail = m_Tail;
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		out = std::move(*next->value());
+		next->value()->~T();
+
+		m_Tail = next;
+		if (tail != &m_Stub)
+			delete tail;
+		return true;
+	}
+
+	// Consumer thread only, may miss pushes that are in progress
+	bool empty() const
+	{
+		return !m_Tail->next.load(std::memory_order_acquire);
+	}
+private:
+	// Producers and the consumer touch different ends, kept on separate cache lines
+	alignas(64) std::atomic<Node*> m_Head; // last pushed node
+	alignas(64) Node* m_Tail;              // consumer's position
+	Node m_Stub;
+};
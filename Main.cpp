@@ -16,6 +16,9 @@ static void print_binary(uint32_t v, uint32_t num_bytes)
 
 #include "ECS.h"
 #include "Command.h"
+#include "CommandQueue.h"
+#include "ConsoleServer.h"
+#include "Benchmark.h"
 
 struct TransformComponent
 {
@@ -59,18 +62,18 @@ static ECS ecs;
 
 static void command_create()
 {
-	printf("created entity %d\n", ecs.create_entity());
+	command_printf("created entity %d\n", ecs.create_entity());
 }
 
 static void command_destroy(uint32_t e)
 {
-	printf("attempting to destroy entity %d\n", e);
+	command_printf("attempting to destroy entity %d\n", e);
 	ecs.destroy_entity(e);
 }
 
-static void command_echo(const std::string& message)
+static void command_echo(std::string_view message)
 {
-	printf("%s\n", message.c_str());
+	command_printf("%.*s\n", (int)message.size(), message.data());
 }
 
 struct vec2
@@ -79,22 +82,25 @@ struct vec2
 };
 
 template<>
-static vec2 command_parse_argument(const std::string& s)
+CommandArgument<vec2> command_parse_argument(std::string_view s)
 {
-	// (1.0f, 2.0f)
-	std::string copy = s;
+	// "1.0 2.0"
+	size_t space = s.find_first_of(' ');
+	if (space == std::string_view::npos)
+		return { {}, CommandError::InvalidArgument };
 
-	vec2 result;
-	result.x = std::strtof(copy.c_str(), nullptr);
-	copy.erase(0, s.find_first_of(' ') + 1);
-	result.y = std::strtof(copy.c_str(), nullptr);
+	CommandArgument<float> x = command_parse_argument<float>(s.substr(0, space));
+	CommandArgument<float> y = command_parse_argument<float>(s.substr(space + 1));
 
+	CommandArgument<vec2> result;
+	result.value = { x.value, y.value };
+	result.error = x.error != CommandError::None ? x.error : y.error;
 	return result;
 }
 
 static void command_print(vec2 v)
 {
-	printf("[%f, %f]\n", v.x, v.y);
+	command_printf("[%f, %f]\n", v.x, v.y);
 }
 
 template<size_t N>
@@ -119,17 +125,100 @@ static void print_bitset(const DynamicBitset& set)
 	printf("\n");
 }
 
-int main()
+// Runs a command file (./app script.txt) and reports how it went
+static int run_script(const CommandHandler& cmd, const char* path)
+{
+	ScriptResult result = cmd.execute_script(path);
+	if (!result.opened) {
+		printf("couldn't open script '%s'\n", path);
+		return 1;
+	}
+
+	printf("%zu/%zu commands in %.3fs (%.0f commands/s)\n", result.executed, result.commands, result.seconds, result.commands_per_second());
+
+	const size_t MaxPrintedErrors = 20;
+	for (size_t i = 0; i < result.errors.size() && i < MaxPrintedErrors; i++)
+	{
+		const ScriptError& error = result.errors[i];
+		printf("line %zu: %s\n", error.line, command_error_string(error.result.error));
+	}
+	if (result.errors.size() > MaxPrintedErrors)
+		printf("... and %zu more errors\n", result.errors.size() - MaxPrintedErrors);
+
+	return result.errors.empty() ? 0 : 1;
+}
+
+#ifdef __linux__
+static int run_console_load(const char* path)
+{
+	ConsoleLoadGenerator::Config config;
+	ConsoleLoadResult result = ConsoleLoadGenerator::run(path, config);
+	if (!result.connected) {
+		printf("couldn't connect to '%s'\n", path);
+		return 1;
+	}
+
+	printf("%zu commands (%zu errors) from %zu clients in %.3fs\n", result.commands, result.errors, config.clients, result.seconds);
+	printf("%.0f commands/s, p50 %.1fus, p99 %.1fus\n", result.commands_per_second, result.p50_microseconds, result.p99_microseconds);
+	return result.errors ? 1 : 0;
+}
+#endif
+
+int main(int argc, char** argv)
 {
 	CommandHandler cmd;
 	cmd.listen_for("create", command_create);
 	cmd.listen_for("destroy", command_destroy);
 	cmd.listen_for("echo", command_echo);
 	cmd.listen_for("print", command_print);
+	cmd.freeze();
+
+	// ./app --bench bitset (or --bench all)
+	if (argc > 2 && strcmp(argv[1], "--bench") == 0)
+		return run_benchmark(argv[2]) ? 0 : 1;
+
+#ifdef __linux__
+	// ./app --load /tmp/ecs.sock drives an instance started with --listen /tmp/ecs.sock
+	if (argc > 2 && strcmp(argv[1], "--load") == 0)
+		return run_console_load(argv[2]);
+
+	// ./app --listen /tmp/ecs.sock takes commands from local tools as well as stdin
+	ConsoleServer server;
+	if (argc > 2 && strcmp(argv[1], "--listen") == 0)
+	{
+		if (!server.listen(argv[2])) {
+			printf("couldn't listen on '%s'\n", argv[2]);
+			return 1;
+		}
+	}
+	else
+#endif
+	if (argc > 1)
+		return run_script(cmd, argv[1]);
+
+	// Input is read and parsed on its own thread, the loop below only runs what's queued at the start of each tick
+	CommandQueue commands(cmd);
+	commands.read_stdin();
+
+	const auto TickInterval = std::chrono::milliseconds(16);
+	const size_t CommandsPerTick = 64;
 
-	char buffer[1024];
-	while (std::cin.getline(buffer, 1024))
+	auto next_tick = std::chrono::steady_clock::now();
+	while (true)
 	{
-		cmd.parse_and_invoke_command(buffer);
+		bool input_closed = commands.input_closed();
+		size_t executed = commands.drain(CommandsPerTick);
+#ifdef __linux__
+		if (server.is_listening())
+			server.poll(cmd, 0, CommandsPerTick); // runs until killed
+		else
+#endif
+		if (input_closed && executed == 0)
+			break; // everything read has been run
+
+		// Simulation update goes here
+
+		next_tick += TickInterval;
+		std::this_thread::sleep_until(next_tick);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file, the contents are paged in by the OS as they're touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const std::string& path) { open(path); }
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file couldn't be opened or mapped, an empty file opens fine with size() == 0
+	bool open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(m_File, &size);
+		m_Size = static_cast<size_t>(size.QuadPart);
+		m_Open = true;
+		if (!m_Size)
+			return true;
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping)
+			m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_Size = static_cast<size_t>(info.st_size);
+		m_Open = true;
+		if (m_Size)
+		{
+			void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				m_Data = static_cast<const uint8_t*>(data);
+				madvise(data, m_Size, MADV_SEQUENTIAL);
+			}
+		}
+		::close(fd); // the mapping keeps the file alive
+#endif
+
+		if (m_Size && !m_Data)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+
+		m_Mapping = nullptr;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data)
+			munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Open = false;
+	}
+
+	const uint8_t* data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+	bool is_open() const { return m_Open; }
+
+	std::string_view view() const { return { reinterpret_cast<const char*>(m_Data), m_Size }; }
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+	bool m_Open = false;
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,516 @@
+#pragma once
+
+#include "DynamicArray.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Elements per chunk handed to a thread, unless a call says otherwise
+static constexpr size_t ParallelDefaultGrain = 16 * 1024;
+
+// Fixed set of worker threads that split index ranges between themselves
+// The calling thread always works on its own job too, so a pool with 0 workers just runs everything inline
+class ThreadPool
+{
+private:
+	struct Job
+	{
+		void(*run)(void* context, size_t begin, size_t end) = nullptr;
+		void* context = nullptr;
+		size_t count = 0;
+		size_t grain = 0;
+		std::atomic<size_t> next = 0;
+		size_t workers = 0; // workers currently inside this job, guarded by m_Mutex
+	};
+public:
+	ThreadPool(size_t workerCount = default_worker_count())
+	{
+		for (size_t i = 0; i < workerCount; i++)
+			m_Workers.emplace_back([this]() { worker_loop(); });
+	}
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_WorkAvailable.notify_all();
+
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Shared pool used by all the parallel_* functions
+	static ThreadPool& get()
+	{
+		static ThreadPool s_Instance;
+		return s_Instance;
+	}
+
+	// Calls fn(begin, end) over [0, count) in chunks of grain indices, returns once every chunk is done
+	template<typename F>
+	void parallel_for(size_t count, size_t grain, F&& fn)
+	{
+		if (!count)
+			return;
+
+		grain = grain ? grain : 1;
+		if (m_Workers.empty() || count <= grain)
+		{
+			fn(size_t(0), count);
+			return;
+		}
+
+		Job job;
+		job.run = [](void* context, size_t begin, size_t end) { (*static_cast<std::remove_reference_t<F>*>(context))(begin, end); };
+		job.context = &fn;
+		job.count = count;
+		job.grain = grain;
+
+		{
+			std::lock_guard lock(m_Mutex);
+			m_Jobs.push_back(&job);
+		}
+		m_WorkAvailable.notify_all();
+
+		run_chunks(job);
+
+		// No new workers can pick the job up once it's off the queue, then just wait for the ones still running a chunk
+		std::unique_lock lock(m_Mutex);
+		auto it = std::find(m_Jobs.begin(), m_Jobs.end(), &job);
+		if (it != m_Jobs.end())
+			m_Jobs.erase(it);
+		m_JobFinished.wait(lock, [&]() { return job.workers == 0; });
+	}
+
+	size_t worker_count() const { return m_Workers.size(); }
+private:
+	static size_t default_worker_count()
+	{
+		size_t hardware = std::thread::hardware_concurrency();
+		return hardware > 1 ? hardware - 1 : 0;
+	}
+
+	static void run_chunks(Job& job)
+	{
+		for (;;)
+		{
+			size_t begin = job.next.fetch_add(job.grain, std::memory_order_relaxed);
+			if (begin >= job.count)
+				return;
+
+			size_t end = begin + job.grain < job.count ? begin + job.grain : job.count;
+			job.run(job.context, begin, end);
+		}
+	}
+
+	void worker_loop()
+	{
+		std::unique_lock lock(m_Mutex);
+		for (;;)
+		{
+			m_WorkAvailable.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+			if (m_Stopping)
+				return;
+
+			Job* job = m_Jobs.front();
+			if (job->next.load(std::memory_order_relaxed) >= job->count)
+			{
+				// Every chunk is taken already
+				m_Jobs.pop_front();
+				continue;
+			}
+
+			job->workers++;
+			lock.unlock();
+			run_chunks(*job);
+			lock.lock();
+
+			if (!m_Jobs.empty() && m_Jobs.front() == job)
+				m_Jobs.pop_front();
+			if (--job->workers == 0)
+				m_JobFinished.notify_all();
+		}
+	}
+private:
+	std::vector<std::thread> m_Workers;
+	std::deque<Job*> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_JobFinished;
+	bool m_Stopping = false;
+};
+
+// All of these work on raw pointer ranges, or on any contiguous container with data() and size() (DynamicArray, std::vector, ...)
+
+// Calls fn(element) for every element
+template<typename T, typename F>
+void parallel_for_each(T* data, size_t count, F fn, size_t grain = ParallelDefaultGrain)
+{
+	ThreadPool::get().parallel_for(count, grain, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			fn(data[i]);
+	});
+}
+template<typename Range, typename F>
+void parallel_for_each(Range& range, F fn, size_t grain = ParallelDefaultGrain)
+{
+	parallel_for_each(range.data(), range.size(), fn, grain);
+}
+
+// output[i] = fn(input[i]), output must have room for count elements (and may be the same as input)
+template<typename T, typename U, typename F>
+void parallel_transform(const T* input, size_t count, U* output, F fn, size_t grain = ParallelDefaultGrain)
+{
+	ThreadPool::get().parallel_for(count, grain, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			output[i] = fn(input[i]);
+	});
+}
+template<typename Range, typename U, typename F>
+void parallel_transform(const Range& range, U* output, F fn, size_t grain = ParallelDefaultGrain)
+{
+	parallel_transform(range.data(), range.size(), output, fn, grain);
+}
+
+// Folds every element into init with op, op must be associative
+// Chunks are always combined in order, so the result is the same for any thread count
+template<typename T, typename U, typename Op>
+U parallel_reduce(const T* data, size_t count, U init, Op op, size_t grain = ParallelDefaultGrain)
+{
+	if (!count)
+		return init;
+
+	grain = grain ? grain : 1;
+	size_t chunks = (count + grain - 1) / grain;
+	std::vector<U> partials(chunks);
+
+	ThreadPool::get().parallel_for(chunks, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			size_t begin = chunk * grain;
+			size_t end = std::min(begin + grain, count);
+
+			U value = data[begin];
+			for (size_t i = begin + 1; i < end; i++)
+				value = op(value, data[i]);
+			partials[chunk] = value;
+		}
+	});
+
+	for (const U& partial : partials)
+		init = op(init, partial);
+	return init;
+}
+template<typename Range, typename U, typename Op>
+U parallel_reduce(const Range& range, U init, Op op, size_t grain = ParallelDefaultGrain)
+{
+	return parallel_reduce(range.data(), range.size(), init, op, grain);
+}
+
+// output[i] = input[0] op input[1] op ... op input[i], output may be the same as input
+// Two passes: each chunk reduces itself, then each chunk scans starting from the sum of the chunks before it
+template<typename T, typename Op>
+void parallel_inclusive_scan(const T* input, size_t count, T* output, Op op, size_t grain = ParallelDefaultGrain)
+{
+	if (!count)
+		return;
+
+	grain = grain ? grain : 1;
+	size_t chunks = (count + grain - 1) / grain;
+	std::vector<T> sums(chunks);
+
+	ThreadPool& pool = ThreadPool::get();
+	pool.parallel_for(chunks, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			size_t begin = chunk * grain;
+			size_t end = std::min(begin + grain, count);
+
+			T value = input[begin];
+			for (size_t i = begin + 1; i < end; i++)
+				value = op(value, input[i]);
+			sums[chunk] = value;
+		}
+	});
+
+	// sums[i] becomes the total of every chunk before i (unused for the first chunk)
+	T running = sums[0];
+	for (size_t chunk = 1; chunk < chunks; chunk++)
+	{
+		T total = sums[chunk];
+		sums[chunk] = running;
+		running = op(running, total);
+	}
+
+	pool.parallel_for(chunks, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			size_t begin = chunk * grain;
+			size_t end = std::min(begin + grain, count);
+
+			T value = chunk ? op(sums[chunk], input[begin]) : input[begin];
+			output[begin] = value;
+			for (size_t i = begin + 1; i < end; i++)
+				output[i] = value = op(value, input[i]);
+		}
+	});
+}
+template<typename Range, typename T, typename Op>
+void parallel_inclusive_scan(const Range& range, T* output, Op op, size_t grain = ParallelDefaultGrain)
+{
+	parallel_inclusive_scan(range.data(), range.size(), output, op, grain);
+}
+
+namespace parallel_detail
+{
+	// Number of elements from a among the first k of the merge of a and b, found by binary search
+	// Ties take from a first, which keeps the merge stable
+	template<typename T, typename Compare>
+	size_t merge_split(const T* a, size_t aCount, const T* b, size_t bCount, size_t k, Compare& compare)
+	{
+		size_t low = k > bCount ? k - bCount : 0;
+		size_t high = std::min(k, aCount);
+		while (low < high)
+		{
+			size_t middle = low + (high - low) / 2;
+			if (!compare(b[k - middle - 1], a[middle]))
+				low = middle + 1; // a[middle] is still part of the first k
+			else
+				high = middle;
+		}
+		return low;
+	}
+
+	// Moves the merge of [a, aEnd) and [b, bEnd) to out, constructing the elements when out is uninitialized memory
+	template<bool Construct, typename T, typename Compare>
+	void merge_moving(T* a, T* aEnd, T* b, T* bEnd, T* out, Compare& compare)
+	{
+		if constexpr (!Construct || std::is_trivially_copyable_v<T>)
+		{
+			std::merge(std::make_move_iterator(a), std::make_move_iterator(aEnd),
+				std::make_move_iterator(b), std::make_move_iterator(bEnd), out, compare);
+		}
+		else
+		{
+			while (a != aEnd && b != bEnd)
+				new (out++) T(std::move(compare(*b, *a) ? *b++ : *a++));
+			out = std::uninitialized_move(a, aEnd, out);
+			std::uninitialized_move(b, bEnd, out);
+		}
+	}
+
+	// One merge pass, every pair of runs of width elements in source is merged into destination
+	// Pairs are split into grain sized pieces of output, so even the last pass (a single pair) runs on every thread
+	template<bool Construct, typename T, typename Compare>
+	void merge_pass(T* source, T* destination, size_t count, size_t width, size_t grain, Compare& compare, std::vector<size_t>& splits)
+	{
+		// width is grain times a power of two, so a piece never spans two pairs
+		size_t pieces = (count + grain - 1) / grain;
+		auto pair_of = [&](size_t piece, size_t& pairBegin, size_t& middle, size_t& pairEnd)
+		{
+			pairBegin = piece * grain / (width * 2) * (width * 2);
+			middle = std::min(pairBegin + width, count);
+			pairEnd = std::min(pairBegin + width * 2, count);
+		};
+
+		// Where each piece starts in the first run, found before anything is moved out of source
+		splits.resize(pieces);
+		ThreadPool& pool = ThreadPool::get();
+		pool.parallel_for(pieces, 1, [&](size_t first, size_t last)
+		{
+			for (size_t piece = first; piece < last; piece++)
+			{
+				size_t pairBegin, middle, pairEnd;
+				pair_of(piece, pairBegin, middle, pairEnd);
+				splits[piece] = merge_split(source + pairBegin, middle - pairBegin, source + middle, pairEnd - middle, piece * grain - pairBegin, compare);
+			}
+		});
+
+		pool.parallel_for(pieces, 1, [&](size_t first, size_t last)
+		{
+			for (size_t piece = first; piece < last; piece++)
+			{
+				size_t pairBegin, middle, pairEnd;
+				pair_of(piece, pairBegin, middle, pairEnd);
+
+				size_t begin = piece * grain;
+				size_t end = std::min(begin + grain, count);
+				size_t aFirst = pairBegin + splits[piece];
+				size_t aLast = end == pairEnd ? middle : pairBegin + splits[piece + 1];
+				size_t bFirst = middle + (begin - aFirst);
+				size_t bLast = middle + (end - aLast);
+
+				merge_moving<Construct>(source + aFirst, source + aLast, source + bFirst, source + bLast, destination + begin, compare);
+			}
+		});
+	}
+}
+
+// Merge sort for any T: every chunk is std::sort'ed on its own, then runs are merged pairwise until one is left
+// Each merge is split between the threads by binary searching where every grain sized piece of its output starts in the two runs
+// Stable only within equal keys of the same chunk, use parallel_radix_sort for plain numeric keys
+template<typename T, typename Compare = std::less<T>>
+void parallel_sort(T* data, size_t count, Compare compare = Compare(), size_t grain = ParallelDefaultGrain)
+{
+	grain = grain ? grain : 1;
+	if (count <= grain)
+	{
+		std::sort(data, data + count, compare);
+		return;
+	}
+
+	ThreadPool& pool = ThreadPool::get();
+	size_t chunks = (count + grain - 1) / grain;
+	pool.parallel_for(chunks, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+			std::sort(data + chunk * grain, data + std::min((chunk + 1) * grain, count), compare);
+	});
+
+	// Uninitialized, the first pass constructs every element in it
+	HeapAllocator& allocator = HeapAllocator::get();
+	T* buffer = static_cast<T*>(allocator.allocate(count * sizeof(T), alignof(T)));
+
+	// Ping-pong between data and buffer, each pass doubles the run width
+	std::vector<size_t> splits;
+	parallel_detail::merge_pass<true>(data, buffer, count, grain, grain, compare, splits);
+	T* source = buffer;
+	T* destination = data;
+	for (size_t width = grain * 2; width < count; width *= 2)
+	{
+		parallel_detail::merge_pass<false>(source, destination, count, width, grain, compare, splits);
+		std::swap(source, destination);
+	}
+
+	if (source != data)
+	{
+		pool.parallel_for(count, grain, [&](size_t begin, size_t end)
+		{
+			std::move(buffer + begin, buffer + end, data + begin);
+		});
+	}
+
+	std::destroy_n(buffer, count);
+	allocator.deallocate(buffer, count * sizeof(T), alignof(T));
+}
+template<typename Range, typename Compare = std::less<>>
+void parallel_sort(Range& range, Compare compare = Compare(), size_t grain = ParallelDefaultGrain)
+{
+	parallel_sort(range.data(), range.size(), compare, grain);
+}
+
+// Maps a numeric key to an unsigned integer that sorts the same way
+template<typename T>
+auto radix_sort_key(T value)
+{
+	using Unsigned = std::conditional_t<sizeof(T) == 1, uint8_t, std::conditional_t<sizeof(T) == 2, uint16_t,
+		std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+	constexpr Unsigned SignBit = Unsigned(1) << (sizeof(T) * 8 - 1);
+
+	Unsigned bits;
+	memcpy(&bits, &value, sizeof(T));
+
+	if constexpr (std::is_floating_point_v<T>)
+		return Unsigned((bits & SignBit) ? ~bits : bits | SignBit); // negatives sort reversed, so flip them entirely
+	else if constexpr (std::is_signed_v<T>)
+		return Unsigned(bits ^ SignBit);
+	else
+		return bits;
+}
+
+// LSD radix sort on 8-bit digits for integer and floating point keys, stable
+// Each pass counts digits per chunk in parallel, computes where every chunk writes each digit, then scatters in parallel
+// Passes where every key has the same digit are skipped
+template<typename T>
+void parallel_radix_sort(T* data, size_t count, size_t grain = ParallelDefaultGrain)
+{
+	static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+		"parallel_radix_sort() only sorts integer and floating point keys");
+
+	if (count < 2)
+		return;
+
+	grain = grain ? grain : 1;
+	size_t chunks = (count + grain - 1) / grain;
+	std::vector<size_t> offsets(chunks * 256);
+
+	ThreadPool& pool = ThreadPool::get();
+	DynamicArray<T> buffer(count);
+	buffer.resize_uninitialized(count);
+
+	T* source = data;
+	T* destination = buffer.data();
+	for (size_t shift = 0; shift < sizeof(T) * 8; shift += 8)
+	{
+		pool.parallel_for(chunks, 1, [&](size_t first, size_t last)
+		{
+			for (size_t chunk = first; chunk < last; chunk++)
+			{
+				size_t* histogram = &offsets[chunk * 256];
+				std::fill(histogram, histogram + 256, 0);
+
+				size_t end = std::min((chunk + 1) * grain, count);
+				for (size_t i = chunk * grain; i < end; i++)
+					histogram[(radix_sort_key(source[i]) >> shift) & 0xFF]++;
+			}
+		});
+
+		// Turn the counts into write positions: digit-major, then chunk order, which keeps the sort stable
+		size_t position = 0;
+		bool sameDigit = false;
+		for (size_t digit = 0; digit < 256; digit++)
+		{
+			size_t digitStart = position;
+			for (size_t chunk = 0; chunk < chunks; chunk++)
+			{
+				size_t& slot = offsets[chunk * 256 + digit];
+				size_t digitCount = slot;
+				slot = position;
+				position += digitCount;
+			}
+
+			sameDigit |= position - digitStart == count;
+		}
+
+		// Scattering wouldn't change the order
+		if (sameDigit)
+			continue;
+
+		pool.parallel_for(chunks, 1, [&](size_t first, size_t last)
+		{
+			for (size_t chunk = first; chunk < last; chunk++)
+			{
+				size_t* positions = &offsets[chunk * 256];
+				size_t end = std::min((chunk + 1) * grain, count);
+				for (size_t i = chunk * grain; i < end; i++)
+					destination[positions[(radix_sort_key(source[i]) >> shift) & 0xFF]++] = source[i];
+			}
+		});
+
+		std::swap(source, destination);
+	}
+
+	if (source != data)
+		memcpy(data, source, count * sizeof(T));
+}
+template<typename Range>
+void parallel_radix_sort(Range& range, size_t grain = ParallelDefaultGrain)
+{
+	parallel_radix_sort(range.data(), range.size(), grain);
+}
@@ -1,27 +1,117 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Allocator.h"
+
 // Unique
 
+// Deleter used by unique_ptr unless it's given another one
 template<typename T>
-class unique_ptr
+struct default_delete
+{
+	void operator()(T* ptr) const { delete ptr; }
+};
+
+// Holds the deleter, a stateless one is a base class so it takes up no space (empty base optimization)
+template<typename Deleter, bool Empty = std::is_empty_v<Deleter> && !std::is_final_v<Deleter>>
+class unique_ptr_deleter : private Deleter
+{
+public:
+	unique_ptr_deleter() = default;
+	unique_ptr_deleter(Deleter deleter)
+		: Deleter(std::move(deleter)) {}
+
+	Deleter& get_deleter() { return *this; }
+	const Deleter& get_deleter() const { return *this; }
+};
+
+template<typename Deleter>
+class unique_ptr_deleter<Deleter, false>
 {
+public:
+	unique_ptr_deleter() = default;
+	unique_ptr_deleter(Deleter deleter)
+		: m_Deleter(std::move(deleter)) {}
+
+	Deleter& get_deleter() { return m_Deleter; }
+	const Deleter& get_deleter() const { return m_Deleter; }
+private:
+	Deleter m_Deleter;
+};
+
+// Sole owner of an object, which is handed to Deleter when the pointer is reset or destroyed
+// With a stateless deleter (like default_delete) it's the size of a raw pointer
+template<typename T, typename Deleter = default_delete<T>>
+class unique_ptr : private unique_ptr_deleter<Deleter>
+{
+private:
+	using Base = unique_ptr_deleter<Deleter>;
 public:
 	unique_ptr() = default;
+	unique_ptr(std::nullptr_t) {}
 	unique_ptr(const unique_ptr&) = delete;
 	unique_ptr(unique_ptr&& other) noexcept
-		: m_Ptr(other.m_Ptr)
+		: Base(std::move(other.get_deleter())), m_Ptr(other.release())
 	{
-		other.m_Ptr = nullptr;
 	}
 	unique_ptr(T* raw)
 		: m_Ptr(raw)
 	{
 	}
+	unique_ptr(T* raw, Deleter deleter)
+		: Base(std::move(deleter)), m_Ptr(raw)
+	{
+	}
 	~unique_ptr()
 	{
-		delete m_Ptr;
+		if (m_Ptr)
+			get_deleter()(m_Ptr);
 	}
 	unique_ptr& operator=(const unique_ptr&) = delete;
+	unique_ptr& operator=(unique_ptr&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset(other.release());
+			get_deleter() = std::move(other.get_deleter());
+		}
+		return *this;
+	}
+	unique_ptr& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	// Gives up ownership without deleting, the caller is responsible for the object from now on
+	T* release()
+	{
+		T* ptr = m_Ptr;
+		m_Ptr = nullptr;
+		return ptr;
+	}
+
+	// Deletes the current object (if any) and takes ownership of ptr
+	void reset(T* ptr = nullptr)
+	{
+		T* old = m_Ptr;
+		m_Ptr = ptr;
+		if (old)
+			get_deleter()(old);
+	}
+
+	void swap(unique_ptr& other) noexcept
+	{
+		std::swap(m_Ptr, other.m_Ptr);
+		std::swap(get_deleter(), other.get_deleter());
+	}
+
+	using Base::get_deleter;
 
 	T* get() { return m_Ptr; }
 	const T* get() const { return m_Ptr; }
@@ -43,119 +133,278 @@ static unique_ptr<T> make_unique(Args&&... args)
 	return unique_ptr<T>{ new T(std::forward<Args>(args)...) };
 }
 
-// Shared
-
+// Fixed number of T slots carved out of one PoolAllocator, for objects that are created and destroyed all the time (messages, particles)
+// acquire() constructs into a free slot and hands back a unique_ptr that destroys the object and returns the slot when it goes away,
+// so churning through objects never touches the global heap
+// Not thread safe, and every handle has to be gone before the pool is destroyed
 template<typename T>
-class shared_ptr
+class ObjectPool
 {
 public:
-	struct control_block_t
+	// Stateful deleter, a Handle is two pointers wide
+	struct Deleter
 	{
-		std::atomic<size_t> reference_count = 0;
+		ObjectPool* pool = nullptr;
 
-		virtual ~control_block_t() = default;
-		virtual void destroy_managed() {}
+		void operator()(T* object) const { pool->destroy(object); }
+	};
 
-		void add_ref()
-		{
-			reference_count++;
-		}
+	using Handle = unique_ptr<T, Deleter>;
+public:
+	ObjectPool(size_t capacity)
+		: m_Pool(sizeof(T), capacity, alignof(T) > alignof(void*) ? alignof(T) : alignof(void*)), m_Capacity(capacity)
+	{
+	}
+	~ObjectPool()
+	{
+		ASSERT(m_Pool.free_count() == m_Capacity && "ObjectPool destroyed while objects are still in use");
+	}
 
-		void drop_ref()
-		{
-			reference_count--;
-			if (reference_count != 0)
-				return;
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
 
-			// destroy/delete managed object and self
-			destroy_managed();
-			delete this;
-		}
-	};
+	// Empty handle if every slot is in use
+	template<typename... Args>
+	Handle acquire(Args&&... args)
+	{
+		if (m_Pool.free_count() == 0)
+			return Handle(nullptr, Deleter{ this });
+
+		void* memory = m_Pool.allocate(sizeof(T), alignof(T));
+		return Handle(new (memory) T(std::forward<Args>(args)...), Deleter{ this });
+	}
 
-	struct inplace_control_block : public control_block_t
+	size_t capacity() const { return m_Capacity; }
+	size_t free_count() const { return m_Pool.free_count(); }
+	size_t in_use() const { return m_Capacity - m_Pool.free_count(); }
+private:
+	void destroy(T* object)
 	{
-		T managed;
+		object->~T();
+		m_Pool.deallocate(object, sizeof(T), alignof(T));
+	}
+private:
+	PoolAllocator m_Pool;
+	size_t m_Capacity = 0;
+};
 
-		template<typename... Args>
-		inplace_control_block(Args&&... args)
-			: managed(std::forward<Args>(args)...)
-		{
-		}
-	};
+// Reference count operations for both plain and atomic counts, each returns the count from before
+// Increments can be relaxed, only the decrement that reaches 0 has to see every other thread's writes to the object
+inline size_t shared_count_increment(size_t& count) { return count++; }
+inline size_t shared_count_decrement(size_t& count) { return count--; }
+inline size_t shared_count_load(const size_t& count) { return count; }
+inline size_t shared_count_increment(std::atomic<size_t>& count) { return count.fetch_add(1, std::memory_order_relaxed); }
+inline size_t shared_count_decrement(std::atomic<size_t>& count) { return count.fetch_sub(1, std::memory_order_acq_rel); }
+inline size_t shared_count_load(const std::atomic<size_t>& count) { return count.load(std::memory_order_relaxed); }
+
+// Reference counts shared by every pointer to one object
+// Count is std::atomic<size_t> for objects shared between threads, or a plain size_t when everything stays on one thread
+// weak counts the weak pointers, plus one held by all the strong ones together, so the block outlives the last weak pointer or the object, whichever is later
+template<typename Count>
+struct shared_control_block
+{
+	Count strong = 1;
+	Count weak = 1;
+
+	virtual ~shared_control_block() = default;
+	virtual void destroy_managed() = 0; // strong count hit 0
+	virtual void destroy_self() = 0;    // weak count hit 0
+
+	void add_ref() { shared_count_increment(strong); }
+	void add_weak_ref() { shared_count_increment(weak); }
+
+	void drop_ref()
+	{
+		if (shared_count_decrement(strong) != 1)
+			return;
+
+		destroy_managed();
+		drop_weak_ref();
+	}
 
-	struct dynamic_control_block : public control_block_t
+	void drop_weak_ref()
 	{
-		T* managed = nullptr;
+		if (shared_count_decrement(weak) == 1)
+			destroy_self();
+	}
 
-		dynamic_control_block(T* managed)
-			: managed(managed)
+	// Adds a strong reference unless the object is already gone
+	bool try_add_ref()
+	{
+		if constexpr (std::is_integral_v<Count>)
 		{
-			control_block_t::add_ref();
+			if (strong == 0)
+				return false;
+			strong++;
+			return true;
 		}
-
-		void destroy_managed() override
+		else
 		{
-			delete managed;
+			size_t count = strong.load(std::memory_order_relaxed);
+			while (count != 0)
+			{
+				if (strong.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+					return true;
+			}
+			return false;
 		}
-	};
-public:
-	shared_ptr() = default;
-	shared_ptr(control_block_t* control, T* ptr)
-		: m_control(control), m_ptr(ptr)
+	}
+
+	size_t use_count() const { return shared_count_load(strong); }
+};
+
+// Owns an object allocated on its own, ie. shared_ptr<T>(new T)
+template<typename T, typename Count>
+struct pointer_control_block : public shared_control_block<Count>
+{
+	T* managed = nullptr;
+
+	pointer_control_block(T* managed)
+		: managed(managed)
+	{
+	}
+
+	void destroy_managed() override { delete managed; }
+	void destroy_self() override { delete this; }
+};
+
+// Holds the object itself, so make_shared() is a single allocation and the counts sit next to the object
+template<typename T, typename Count>
+struct inplace_control_block : public shared_control_block<Count>
+{
+	alignas(T) unsigned char storage[sizeof(T)];
+
+	template<typename... Args>
+	inplace_control_block(Args&&... args)
 	{
-		m_control->add_ref();
+		new (storage) T(std::forward<Args>(args)...);
 	}
-	shared_ptr(T* ptr)
+
+	T* managed() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+	void destroy_managed() override { managed()->~T(); }
+	void destroy_self() override { delete this; }
+};
+
+// Holds the object inline like inplace_control_block, but the block comes from (and goes back to) an IAllocator
+template<typename T, typename Count>
+struct allocator_control_block : public shared_control_block<Count>
+{
+	IAllocator* allocator = nullptr;
+	alignas(T) unsigned char storage[sizeof(T)];
+
+	template<typename... Args>
+	allocator_control_block(IAllocator* allocator, Args&&... args)
+		: allocator(allocator)
+	{
+		new (storage) T(std::forward<Args>(args)...);
+	}
+
+	T* managed() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+	void destroy_managed() override { managed()->~T(); }
+	void destroy_self() override
+	{
+		IAllocator* from = allocator;
+		this->~allocator_control_block();
+		from->deallocate(this, sizeof(allocator_control_block), alignof(allocator_control_block));
+	}
+};
+
+// Bytes allocate_shared<T>() asks its allocator for, ie. the block size to give a PoolAllocator dedicated to T
+template<typename T, typename Count = std::atomic<size_t>>
+static constexpr size_t shared_block_size = sizeof(allocator_control_block<T, Count>);
+template<typename T, typename Count = std::atomic<size_t>>
+static constexpr size_t shared_block_alignment = alignof(allocator_control_block<T, Count>);
+
+template<typename T, typename Count>
+class basic_weak_ptr;
+
+// Reference counted pointer, the object is destroyed with the last basic_shared_ptr to it
+// Use the shared_ptr/local_shared_ptr aliases below
+template<typename T, typename Count>
+class basic_shared_ptr
+{
+public:
+	using control_block_t = shared_control_block<Count>;
+public:
+	basic_shared_ptr() = default;
+	basic_shared_ptr(std::nullptr_t) {}
+	basic_shared_ptr(T* ptr)
 		: m_ptr(ptr)
 	{
-		m_control = new dynamic_control_block(ptr);
+		if (ptr)
+			m_control = new pointer_control_block<T, Count>(ptr);
+	}
+	// Shares ownership of control, which ptr belongs to
+	basic_shared_ptr(control_block_t* control, T* ptr)
+		: m_ptr(ptr), m_control(control)
+	{
+		add_control_ref();
 	}
-	shared_ptr(const shared_ptr<T>& other)
-		: m_control(other.m_control), m_ptr(other.m_ptr)
+	basic_shared_ptr(const basic_shared_ptr& other)
+		: m_ptr(other.m_ptr), m_control(other.m_control)
 	{
 		add_control_ref();
 	}
+	basic_shared_ptr(basic_shared_ptr&& other) noexcept
+		: m_ptr(other.m_ptr), m_control(other.m_control)
+	{
+		other.m_ptr = nullptr;
+		other.m_control = nullptr;
+	}
 
-	~shared_ptr()
+	~basic_shared_ptr()
 	{
 		drop_control_ref();
 	}
 
-	shared_ptr<T>& operator=(const shared_ptr<T>& other)
+	basic_shared_ptr& operator=(const basic_shared_ptr& other)
 	{
-		m_ptr = other.m_ptr;
-		m_control = other.m_control;
-		add_control_ref();
+		// Through a copy, so assigning a pointer to itself (or to something it owns) is fine
+		basic_shared_ptr(other).swap(*this);
+		return *this;
+	}
+	basic_shared_ptr& operator=(basic_shared_ptr&& other) noexcept
+	{
+		basic_shared_ptr(std::move(other)).swap(*this);
 		return *this;
 	}
 
 	T* get() const { return m_ptr; }
+	size_t use_count() const { return m_control ? m_control->use_count() : 0; }
 
 	void reset(T* ptr = nullptr)
 	{
-		drop_control_ref();
-
-		if (!ptr)
-		{
-			m_control = nullptr;
-			m_ptr = nullptr;
-			return;
-		}
+		basic_shared_ptr(ptr).swap(*this);
+	}
 
-		m_ptr = ptr;
-		m_control = new dynamic_control_block(ptr);
+	void swap(basic_shared_ptr& other) noexcept
+	{
+		std::swap(m_ptr, other.m_ptr);
+		std::swap(m_control, other.m_control);
 	}
 
-	bool empty() const { return m_ptr; }
+	bool empty() const { return !m_ptr; }
 	operator bool() const { return m_ptr; }
 
-	T& operator*() { return *m_ptr; }
-	const T& operator*() const { return *m_ptr; }
+	T& operator*() const { return *m_ptr; }
+	T* operator->() const { return m_ptr; }
+
+	bool operator==(const basic_shared_ptr& other) const { return m_ptr == other.m_ptr; }
+	bool operator!=(const basic_shared_ptr& other) const { return m_ptr != other.m_ptr; }
 
-	T* operator->() { return m_ptr; }
-	const T* operator->() const { return m_ptr; }
+	// Wraps a control block that already holds the one reference this pointer takes over
+	static basic_shared_ptr adopt(control_block_t* control, T* ptr)
+	{
+		basic_shared_ptr result;
+		result.m_control = control;
+		result.m_ptr = ptr;
+		return result;
+	}
 private:
+	friend class basic_weak_ptr<T, Count>;
+
 	void add_control_ref()
 	{
 		if (m_control)
@@ -169,5 +418,302 @@ private:
 private:
 	T* m_ptr = nullptr;
 	control_block_t* m_control = nullptr;
+};
+
+// Refers to an object owned by basic_shared_ptrs without keeping it alive
+// lock() hands out a basic_shared_ptr if the object still exists
+template<typename T, typename Count>
+class basic_weak_ptr
+{
+public:
+	using control_block_t = shared_control_block<Count>;
+public:
+	basic_weak_ptr() = default;
+	basic_weak_ptr(const basic_shared_ptr<T, Count>& shared)
+		: m_ptr(shared.m_ptr), m_control(shared.m_control)
+	{
+		add_control_ref();
+	}
+	basic_weak_ptr(const basic_weak_ptr& other)
+		: m_ptr(other.m_ptr), m_control(other.m_control)
+	{
+		add_control_ref();
+	}
+	basic_weak_ptr(basic_weak_ptr&& other) noexcept
+		: m_ptr(other.m_ptr), m_control(other.m_control)
+	{
+		other.m_ptr = nullptr;
+		other.m_control = nullptr;
+	}
+
+	~basic_weak_ptr()
+	{
+		drop_control_ref();
+	}
+
+	basic_weak_ptr& operator=(const basic_weak_ptr& other)
+	{
+		basic_weak_ptr(other).swap(*this);
+		return *this;
+	}
+	basic_weak_ptr& operator=(basic_weak_ptr&& other) noexcept
+	{
+		basic_weak_ptr(std::move(other)).swap(*this);
+		return *this;
+	}
+	basic_weak_ptr& operator=(const basic_shared_ptr<T, Count>& shared)
+	{
+		basic_weak_ptr(shared).swap(*this);
+		return *this;
+	}
+
+	// Empty if the object has been destroyed
+	basic_shared_ptr<T, Count> lock() const
+	{
+		if (m_control && m_control->try_add_ref())
+			return basic_shared_ptr<T, Count>::adopt(m_control, m_ptr);
+		return {};
+	}
+
+	bool expired() const { return use_count() == 0; }
+	size_t use_count() const { return m_control ? m_control->use_count() : 0; }
+
+	void reset()
+	{
+		basic_weak_ptr().swap(*this);
+	}
+
+	void swap(basic_weak_ptr& other) noexcept
+	{
+		std::swap(m_ptr, other.m_ptr);
+		std::swap(m_control, other.m_control);
+	}
+private:
+	void add_control_ref()
+	{
+		if (m_control)
+			m_control->add_weak_ref();
+	}
+	void drop_control_ref()
+	{
+		if (m_control)
+			m_control->drop_weak_ref();
+	}
+private:
+	T* m_ptr = nullptr;
+	control_block_t* m_control = nullptr;
+};
+
+// Counts are atomic, safe to copy and drop from several threads
+template<typename T>
+using shared_ptr = basic_shared_ptr<T, std::atomic<size_t>>;
+template<typename T>
+using weak_ptr = basic_weak_ptr<T, std::atomic<size_t>>;
+
+// Plain integer counts for objects that never leave one thread, copying is an increment instead of a locked instruction
+template<typename T>
+using local_shared_ptr = basic_shared_ptr<T, size_t>;
+template<typename T>
+using local_weak_ptr = basic_weak_ptr<T, size_t>;
+
+// Allocates the counts and the object together
+template<typename T, typename Count, typename... Args>
+static basic_shared_ptr<T, Count> make_basic_shared(Args&&... args)
+{
+	auto* control = new inplace_control_block<T, Count>(std::forward<Args>(args)...);
+	return basic_shared_ptr<T, Count>::adopt(control, control->managed());
+}
+
+template<typename T, typename... Args>
+static shared_ptr<T> make_shared(Args&&... args)
+{
+	return make_basic_shared<T, std::atomic<size_t>>(std::forward<Args>(args)...);
+}
+
+template<typename T, typename... Args>
+static local_shared_ptr<T> make_local_shared(Args&&... args)
+{
+	return make_basic_shared<T, size_t>(std::forward<Args>(args)...);
+}
+
+// Same as make_basic_shared(), but the counts and the object are allocated from allocator, which has to outlive the object
+// With a PoolAllocator of shared_block_size<T> blocks, creating and dropping shared objects never touches the global heap
+// The allocator is called from whichever thread drops the last reference, so give shared_ptr a thread safe one
+// (ie. ThreadSafePoolAllocator), a plain PoolAllocator is only safe with local_shared_ptr or when everything stays on one thread
+template<typename T, typename Count, typename... Args>
+static basic_shared_ptr<T, Count> allocate_basic_shared(IAllocator& allocator, Args&&... args)
+{
+	using Block = allocator_control_block<T, Count>;
+
+	void* memory = allocator.allocate(sizeof(Block), alignof(Block));
+	Block* control = new (memory) Block(&allocator, std::forward<Args>(args)...);
+	return basic_shared_ptr<T, Count>::adopt(control, control->managed());
+}
+
+template<typename T, typename... Args>
+static shared_ptr<T> allocate_shared(IAllocator& allocator, Args&&... args)
+{
+	return allocate_basic_shared<T, std::atomic<size_t>>(allocator, std::forward<Args>(args)...);
+}
+
+template<typename T, typename... Args>
+static local_shared_ptr<T> allocate_local_shared(IAllocator& allocator, Args&&... args)
+{
+	return allocate_basic_shared<T, size_t>(allocator, std::forward<Args>(args)...);
+}
+
+// Intrusive
+
+// Base for types that carry their own reference count, for use with intrusive_ptr
+// No control block at all: the count lives in the object, so sharing one costs no extra allocation and no extra cache line
+// The object is deleted when the count drops to 0, so it has to be allocated with new (see allocated_ref_counted for allocators)
+//
+// struct Mesh : ref_counted<Mesh> { ... };
+// intrusive_ptr<Mesh> mesh = make_intrusive<Mesh>();
+template<typename Derived, typename Count = std::atomic<size_t>>
+class ref_counted
+{
+public:
+	ref_counted() = default;
+	// Copying the object doesn't copy who refers to it
+	ref_counted(const ref_counted&) {}
+	ref_counted& operator=(const ref_counted&) { return *this; }
+
+	void add_ref() const
+	{
+		shared_count_increment(m_ReferenceCount);
+	}
 
+	void release() const
+	{
+		if (shared_count_decrement(m_ReferenceCount) == 1)
+			delete static_cast<const Derived*>(this);
+	}
+
+	size_t use_count() const { return shared_count_load(m_ReferenceCount); }
+protected:
+	~ref_counted() = default;
+private:
+	mutable Count m_ReferenceCount = 0;
 };
+
+// Pointer to an object with an embedded reference count, T needs add_ref() and release() (see ref_counted)
+// Can be made from a raw pointer at any time, the count travels with the object
+template<typename T>
+class intrusive_ptr
+{
+public:
+	intrusive_ptr() = default;
+	intrusive_ptr(std::nullptr_t) {}
+	intrusive_ptr(T* ptr)
+		: m_ptr(ptr)
+	{
+		if (m_ptr)
+			m_ptr->add_ref();
+	}
+	intrusive_ptr(const intrusive_ptr& other)
+		: intrusive_ptr(other.m_ptr)
+	{
+	}
+	intrusive_ptr(intrusive_ptr&& other) noexcept
+		: m_ptr(other.m_ptr)
+	{
+		other.m_ptr = nullptr;
+	}
+
+	~intrusive_ptr()
+	{
+		if (m_ptr)
+			m_ptr->release();
+	}
+
+	intrusive_ptr& operator=(const intrusive_ptr& other)
+	{
+		intrusive_ptr(other).swap(*this);
+		return *this;
+	}
+	intrusive_ptr& operator=(intrusive_ptr&& other) noexcept
+	{
+		intrusive_ptr(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	T* get() const { return m_ptr; }
+
+	void reset(T* ptr = nullptr)
+	{
+		intrusive_ptr(ptr).swap(*this);
+	}
+
+	void swap(intrusive_ptr& other) noexcept
+	{
+		std::swap(m_ptr, other.m_ptr);
+	}
+
+	operator bool() const { return m_ptr; }
+
+	T& operator*() const { return *m_ptr; }
+	T* operator->() const { return m_ptr; }
+
+	bool operator==(const intrusive_ptr& other) const { return m_ptr == other.m_ptr; }
+	bool operator!=(const intrusive_ptr& other) const { return m_ptr != other.m_ptr; }
+private:
+	T* m_ptr = nullptr;
+};
+
+template<typename T, typename... Args>
+static intrusive_ptr<T> make_intrusive(Args&&... args)
+{
+	return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+// Same as ref_counted, but the object remembers the allocator allocate_intrusive() made it from and is handed back to it when the count drops to 0
+// Costs one pointer per object over ref_counted
+// Like allocate_shared(), the last release() can happen on any thread, with the atomic Count that needs a thread safe allocator (ie. ThreadSafePoolAllocator)
+//
+// struct Particle : allocated_ref_counted<Particle> { ... };
+// intrusive_ptr<Particle> particle = allocate_intrusive<Particle>(particlePool);
+template<typename Derived, typename Count = std::atomic<size_t>>
+class allocated_ref_counted
+{
+public:
+	allocated_ref_counted() = default;
+	// Copying the object doesn't copy who refers to it, or where it lives
+	allocated_ref_counted(const allocated_ref_counted&) {}
+	allocated_ref_counted& operator=(const allocated_ref_counted&) { return *this; }
+
+	void add_ref() const
+	{
+		shared_count_increment(m_ReferenceCount);
+	}
+
+	void release() const
+	{
+		if (shared_count_decrement(m_ReferenceCount) != 1)
+			return;
+
+		IAllocator* allocator = m_Allocator;
+		Derived* object = const_cast<Derived*>(static_cast<const Derived*>(this));
+		object->~Derived();
+		allocator->deallocate(object, sizeof(Derived), alignof(Derived));
+	}
+
+	size_t use_count() const { return shared_count_load(m_ReferenceCount); }
+protected:
+	~allocated_ref_counted() = default;
+private:
+	template<typename T, typename... Args>
+	friend intrusive_ptr<T> allocate_intrusive(IAllocator& allocator, Args&&... args);
+
+	mutable Count m_ReferenceCount = 0;
+	IAllocator* m_Allocator = nullptr;
+};
+
+// Makes a T (derived from allocated_ref_counted<T>) in memory from allocator, which has to outlive the object
+template<typename T, typename... Args>
+intrusive_ptr<T> allocate_intrusive(IAllocator& allocator, Args&&... args)
+{
+	T* object = new (allocator.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	object->m_Allocator = &allocator;
+	return intrusive_ptr<T>(object);
+}
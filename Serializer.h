@@ -1,11 +1,39 @@
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <filesystem>
+#include <cstring>
+#include <memory>
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "DynamicArray.h"
+#include "MappedFile.h"
+
+// Size of the block open_write() collects in memory before handing it to the OS
+static constexpr size_t SerializerBlockSize = 4 * 1024 * 1024;
 
 // Handles opening a file for reading/writing and offers methods to read and write binary data to the file
+// open() reads and writes through a std::fstream, for bulk saving and loading there are two faster modes:
+// open_write() collects everything in a memory block that's written out in SerializerBlockSize chunks,
+// open_read() maps the file into memory so reading (and peeking) is a copy from a pointer that moves forward
+//
+// std::vector, DynamicArray, std::array and std::string are written as a uint64_t element count followed by the elements
+// Trivially copyable elements without their own serialize() go out as one block, aligned to alignof(T) within the file,
+// which is what lets view<T>() hand out a span straight into a mapped file
 class Serializer
 {
+private:
+	enum class Mode
+	{
+		Closed,
+		Stream,        // open()
+		BufferedWrite, // open_write()
+		MappedRead,    // open_read()
+	};
 public:
 	// Determines if a type has a serialize(Serializer&) function
 	template<typename T, typename = void>
@@ -18,24 +46,179 @@ public:
 	struct is_deserializeable_struct_t : std::false_type {};
 	template <typename T>
 	struct is_deserializeable_struct_t<T, std::void_t<decltype(std::declval<T>().deserialize(std::declval<Serializer&>()))>> : std::true_type {};
+
+	// Arrays of T can be copied to and from the file as raw bytes
+	template<typename T>
+	static constexpr bool is_block_serializeable_v = std::is_trivially_copyable_v<T> && !is_serializeable_struct_t<T>::value && !is_deserializeable_struct_t<T>::value;
+
+	// Containers that are written as count + elements and can be resized on read
+	template<typename T>
+	struct is_resizable_array_t : std::false_type {};
+	template<typename T, typename A>
+	struct is_resizable_array_t<std::vector<T, A>> : std::true_type {};
+	template<typename C, typename Tr, typename A>
+	struct is_resizable_array_t<std::basic_string<C, Tr, A>> : std::true_type {};
+	template<typename T, size_t N>
+	struct is_resizable_array_t<DynamicArray<T, N>> : std::true_type {};
+
+	// Element type of a container with data()
+	template<typename T>
+	using array_element_t = std::remove_cv_t<std::remove_pointer_t<decltype(std::declval<T&>().data())>>;
+
+	template<typename T>
+	struct is_fixed_array_t : std::false_type {};
+	template<typename T, size_t N>
+	struct is_fixed_array_t<std::array<T, N>> : std::true_type {};
 public:
 	Serializer() = default;
 	Serializer(const std::string& file) { open(file); }
 
 	~Serializer()
 	{
-		m_File.close();
+		close();
 	}
 
+	Serializer(const Serializer&) = delete;
+	Serializer& operator=(const Serializer&) = delete;
+
 	// Opens a file to prepare for serializing / deserializing data
 	void open(const std::string& file)
 	{
+		close();
+
 		std::ios_base::openmode openFlags = std::ios::out | std::ios::in | std::ios::binary;
 		if (!std::filesystem::exists(file))
 			openFlags |= std::ios::trunc;
-		
+
 		m_File.open(file, openFlags);
 		ASSERT(m_File.is_open());
+		m_Mode = Mode::Stream;
+	}
+
+	// Creates (or truncates) a file for writing only, writes are buffered and go out in large blocks
+	// Everything is on disk once flush() or close() is called, or the serializer is destroyed
+	bool open_write(const std::string& file)
+	{
+		close();
+
+		m_File.open(file, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_File.is_open())
+			return false;
+
+		if (!m_Buffer)
+			m_Buffer = std::make_unique<uint8_t[]>(SerializerBlockSize);
+		m_BufferSize = 0;
+		m_Flushed = 0;
+		m_Mode = Mode::BufferedWrite;
+		return true;
+	}
+
+	// Maps a file for reading only
+	bool open_read(const std::string& file)
+	{
+		close();
+
+		if (!m_Mapping.open(file))
+			return false;
+
+		m_Cursor = m_Mapping.data();
+		m_End = m_Cursor + m_Mapping.size();
+		m_Mode = Mode::MappedRead;
+		return true;
+	}
+
+	void close()
+	{
+		flush();
+
+		m_File.close();
+		m_Mapping.close();
+		m_Cursor = m_End = nullptr;
+		m_Mode = Mode::Closed;
+	}
+
+	// Writes out whatever open_write() has buffered so far
+	void flush()
+	{
+		if (m_Mode != Mode::BufferedWrite || m_BufferSize == 0)
+			return;
+
+		m_File.write(reinterpret_cast<const char*>(m_Buffer.get()), m_BufferSize);
+		ASSERT(m_File.good() && "failed to write serialized data");
+
+		m_Flushed += m_BufferSize;
+		m_BufferSize = 0;
+	}
+
+	bool is_open() const { return m_Mode != Mode::Closed; }
+
+	// Bytes left to read, only known for open_read()
+	size_t remaining() const { return m_End - m_Cursor; }
+
+	// Offset from the start of the file that the next read or write happens at
+	size_t position()
+	{
+		switch (m_Mode)
+		{
+		case Mode::BufferedWrite: return m_Flushed + m_BufferSize;
+		case Mode::MappedRead:    return m_Cursor - m_Mapping.data();
+		case Mode::Stream:        return static_cast<size_t>(m_File.rdbuf()->pubseekoff(0, std::ios::cur));
+		default:                  return 0;
+		}
+	}
+
+	// Writes count elements with no count in front, read them back with read_span() and the same count
+	template<typename T>
+	void write_span(const T* data, size_t count)
+	{
+		if constexpr (is_block_serializeable_v<T>) {
+			write_bytes(data, count * sizeof(T));
+		}
+		else {
+			for (size_t i = 0; i < count; i++)
+				write(data[i]);
+		}
+	}
+
+	template<typename T>
+	void write_span(std::span<const T> data)
+	{
+		write_span(data.data(), data.size());
+	}
+
+	template<typename T>
+	void read_span(T* data, size_t count)
+	{
+		if constexpr (is_block_serializeable_v<T>) {
+			read_bytes(data, count * sizeof(T));
+		}
+		else {
+			for (size_t i = 0; i < count; i++)
+				read(data[i]);
+		}
+	}
+
+	template<typename T>
+	void read_span(std::span<T> data)
+	{
+		read_span(data.data(), data.size());
+	}
+
+	// Reads an array written as a container (count + block of elements) without copying it, only for open_read()
+	// The span points into the mapped file and is valid until the serializer is closed
+	template<typename T>
+	std::span<const T> view()
+	{
+		static_assert(is_block_serializeable_v<T>, "view<T>() needs a trivially copyable T without serialize()");
+		ASSERT(m_Mode == Mode::MappedRead && "view<T>() needs open_read()");
+
+		uint64_t count = read<uint64_t>();
+		skip_padding(alignof(T));
+		ASSERT(count <= remaining() / sizeof(T) && "failed to deserialize data");
+
+		std::span<const T> result(reinterpret_cast<const T*>(m_Cursor), count);
+		m_Cursor += count * sizeof(T);
+		return result;
 	}
 
 	// Serializes an object to the file
@@ -43,7 +226,11 @@ public:
 	void write(const T& data)
 	{
 		if constexpr (std::is_arithmetic_v<T>) {
-			m_File.write(reinterpret_cast<const char*>(&data), sizeof(T));
+			write_bytes(&data, sizeof(T));
+		}
+
+		if constexpr (is_resizable_array_t<T>::value || is_fixed_array_t<T>::value) {
+			write_array(data.data(), data.size());
 		}
 
 		if constexpr (is_serializeable_struct_t<T>::value) {
@@ -62,6 +249,15 @@ public:
 	template<typename T>
 	T peek()
 	{
+		if (m_Mode == Mode::MappedRead)
+		{
+			const uint8_t* start = m_Cursor;
+			T result = read<T>();
+			m_Cursor = start;
+
+			return result;
+		}
+
 		auto start = m_File.tellg();
 		T result = read<T>();
 		m_File.seekg(start);
@@ -74,14 +270,34 @@ public:
 	void read(T& result)
 	{
 		if constexpr (std::is_arithmetic_v<T>) {
-			m_File.read(reinterpret_cast<char*>(&result), sizeof(T));
+			read_bytes(&result, sizeof(T));
+		}
+
+		if constexpr (is_resizable_array_t<T>::value) {
+			using Element = array_element_t<T>;
+
+			size_t count = static_cast<size_t>(read<uint64_t>());
+			if constexpr (is_block_serializeable_v<Element>)
+				ASSERT((m_Mode != Mode::MappedRead || count <= remaining() / sizeof(Element)) && "failed to deserialize data");
+
+			// Block elements are overwritten right away, no point zeroing them first
+			if constexpr (is_block_serializeable_v<Element> && requires { result.resize_default_init(count); })
+				result.resize_default_init(count);
+			else
+				result.resize(count);
+
+			read_array_elements(result.data(), count);
+		}
+
+		if constexpr (is_fixed_array_t<T>::value) {
+			size_t count = static_cast<size_t>(read<uint64_t>());
+			ASSERT(count == result.size() && "array size doesn't match the file");
+			read_array_elements(result.data(), count);
 		}
 
 		if constexpr (is_deserializeable_struct_t<T>::value) {
 			result.deserialize(*this);
 		}
-
-		ASSERT(m_File.good() && "failed to deserialize data");
 	}
 
 	// Deserializes a number of objects
@@ -97,7 +313,121 @@ public:
 		T result;
 		read(result);
 		return result;
-	}	
+	}
+private:
+	template<typename T>
+	void write_array(const T* data, size_t count)
+	{
+		write(uint64_t(count));
+		if constexpr (is_block_serializeable_v<T>)
+			write_padding(alignof(T));
+
+		write_span(data, count);
+	}
+
+	// Everything after the count
+	template<typename T>
+	void read_array_elements(T* data, size_t count)
+	{
+		if constexpr (is_block_serializeable_v<T>)
+			skip_padding(alignof(T));
+
+		read_span(data, count);
+	}
+
+	// Padding can be up to alignment - 1 bytes (63 for an alignas(64) T), written in pieces no bigger than the zero buffer
+	void write_padding(size_t alignment)
+	{
+		static const uint8_t zeros[alignof(std::max_align_t)] = {};
+
+		size_t padding = (alignment - position() % alignment) % alignment;
+		while (padding)
+		{
+			size_t size = std::min(padding, sizeof(zeros));
+			write_bytes(zeros, size);
+			padding -= size;
+		}
+	}
+
+	void skip_padding(size_t alignment)
+	{
+		size_t padding = (alignment - position() % alignment) % alignment;
+		if (m_Mode == Mode::MappedRead)
+		{
+			ASSERT(padding <= remaining() && "failed to deserialize data");
+			m_Cursor += padding;
+			return;
+		}
+
+		uint8_t discard[alignof(std::max_align_t)];
+		while (padding)
+		{
+			size_t size = std::min(padding, sizeof(discard));
+			read_bytes(discard, size);
+			padding -= size;
+		}
+	}
+
+	void write_bytes(const void* data, size_t size)
+	{
+		switch (m_Mode)
+		{
+		case Mode::BufferedWrite:
+			if (m_BufferSize + size > SerializerBlockSize)
+			{
+				flush();
+
+				// Too big to be worth copying into the block, goes straight to the file
+				if (size >= SerializerBlockSize)
+				{
+					m_File.write(static_cast<const char*>(data), size);
+					ASSERT(m_File.good() && "failed to write serialized data");
+					m_Flushed += size;
+					return;
+				}
+			}
+
+			memcpy(m_Buffer.get() + m_BufferSize, data, size);
+			m_BufferSize += size;
+			break;
+		case Mode::Stream:
+			m_File.write(static_cast<const char*>(data), size);
+			break;
+		default:
+			ASSERT(false && "serializer isn't open for writing");
+			break;
+		}
+	}
+
+	void read_bytes(void* data, size_t size)
+	{
+		switch (m_Mode)
+		{
+		case Mode::MappedRead:
+			ASSERT(size <= remaining() && "failed to deserialize data");
+			memcpy(data, m_Cursor, size);
+			m_Cursor += size;
+			break;
+		case Mode::Stream:
+			m_File.read(static_cast<char*>(data), size);
+			ASSERT(m_File.good() && "failed to deserialize data");
+			break;
+		default:
+			ASSERT(false && "serializer isn't open for reading");
+			break;
+		}
+	}
 private:
+	Mode m_Mode = Mode::Closed;
 	std::fstream m_File;
-};
\ No newline at end of file
+
+	// open_write()
+	std::unique_ptr<uint8_t[]> m_Buffer;
+	size_t m_BufferSize = 0;
+	size_t m_Flushed = 0; // bytes already in the file
+
+	// open_read()
+	MappedFile m_Mapping;
+	const uint8_t* m_Cursor = nullptr;
+	const uint8_t* m_End = nullptr;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Vectorized search kernels for arrays of arithmetic types
+// Uses AVX2 when compiled with it (/arch:AVX2, -mavx2), SSE2 otherwise on x86, and plain loops everywhere else
+// Comparisons follow operator== exactly (NaN never matches, -0.0 matches 0.0)
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SIMD_SSE2 1
+#endif
+
+// Whether simd_find/simd_count have a vectorized path for T
+template<typename T>
+constexpr bool is_simd_searchable_v = std::is_arithmetic_v<T> && !std::is_same_v<T, long double> &&
+	(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+namespace simd_detail
+{
+#if defined(SIMD_AVX2)
+	using Register = __m256i;
+
+	inline Register load(const void* data) { return _mm256_loadu_si256(static_cast<const Register*>(data)); }
+	inline Register bit_or(Register a, Register b) { return _mm256_or_si256(a, b); }
+	// One bit per byte, so a match on element i sets bits [i * sizeof(T), (i + 1) * sizeof(T))
+	inline uint32_t byte_mask(Register r) { return static_cast<uint32_t>(_mm256_movemask_epi8(r)); }
+
+	template<typename T>
+	Register splat(T value)
+	{
+		if constexpr (std::is_same_v<T, float>)
+			return _mm256_castps_si256(_mm256_set1_ps(value));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm256_castpd_si256(_mm256_set1_pd(value));
+		else if constexpr (sizeof(T) == 1)
+			return _mm256_set1_epi8(static_cast<char>(value));
+		else if constexpr (sizeof(T) == 2)
+			return _mm256_set1_epi16(static_cast<short>(value));
+		else if constexpr (sizeof(T) == 4)
+			return _mm256_set1_epi32(static_cast<int>(value));
+		else
+			return _mm256_set1_epi64x(static_cast<long long>(value));
+	}
+
+	template<typename T>
+	Register equal(Register a, Register b)
+	{
+		if constexpr (std::is_same_v<T, float>)
+			return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_EQ_OQ));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_EQ_OQ));
+		else if constexpr (sizeof(T) == 1)
+			return _mm256_cmpeq_epi8(a, b);
+		else if constexpr (sizeof(T) == 2)
+			return _mm256_cmpeq_epi16(a, b);
+		else if constexpr (sizeof(T) == 4)
+			return _mm256_cmpeq_epi32(a, b);
+		else
+			return _mm256_cmpeq_epi64(a, b);
+	}
+#elif defined(SIMD_SSE2)
+	using Register = __m128i;
+
+	inline Register load(const void* data) { return _mm_loadu_si128(static_cast<const Register*>(data)); }
+	inline Register bit_or(Register a, Register b) { return _mm_or_si128(a, b); }
+	inline uint32_t byte_mask(Register r) { return static_cast<uint32_t>(_mm_movemask_epi8(r)); }
+
+	template<typename T>
+	Register splat(T value)
+	{
+		if constexpr (std::is_same_v<T, float>)
+			return _mm_castps_si128(_mm_set1_ps(value));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm_castpd_si128(_mm_set1_pd(value));
+		else if constexpr (sizeof(T) == 1)
+			return _mm_set1_epi8(static_cast<char>(value));
+		else if constexpr (sizeof(T) == 2)
+			return _mm_set1_epi16(static_cast<short>(value));
+		else if constexpr (sizeof(T) == 4)
+			return _mm_set1_epi32(static_cast<int>(value));
+		else
+			return _mm_set1_epi64x(static_cast<long long>(value));
+	}
+
+	template<typename T>
+	Register equal(Register a, Register b)
+	{
+		if constexpr (std::is_same_v<T, float>)
+			return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+		else if constexpr (std::is_same_v<T, double>)
+			return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+		else if constexpr (sizeof(T) == 1)
+			return _mm_cmpeq_epi8(a, b);
+		else if constexpr (sizeof(T) == 2)
+			return _mm_cmpeq_epi16(a, b);
+		else if constexpr (sizeof(T) == 4)
+			return _mm_cmpeq_epi32(a, b);
+		else
+		{
+			// No 64-bit compare before SSE4.1, both 32-bit halves have to match
+			Register halves = _mm_cmpeq_epi32(a, b);
+			return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+		}
+	}
+#endif
+}
+
+// Returns the index of the first element equal to value, or count if there is none
+template<typename T>
+size_t simd_find(const T* data, size_t count, T value)
+{
+	size_t i = 0;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+	if constexpr (is_simd_searchable_v<T>)
+	{
+		using namespace simd_detail;
+		constexpr size_t Lanes = sizeof(Register) / sizeof(T);
+		Register needle = splat(value);
+
+		// 4 registers per iteration, only look at which one matched once any of them did
+		for (; i + Lanes * 4 <= count; i += Lanes * 4)
+		{
+			Register r0 = equal<T>(load(data + i), needle);
+			Register r1 = equal<T>(load(data + i + Lanes), needle);
+			Register r2 = equal<T>(load(data + i + Lanes * 2), needle);
+			Register r3 = equal<T>(load(data + i + Lanes * 3), needle);
+			if (!byte_mask(bit_or(bit_or(r0, r1), bit_or(r2, r3))))
+				continue;
+
+			if (uint32_t mask = byte_mask(r0)) return i + std::countr_zero(mask) / sizeof(T);
+			if (uint32_t mask = byte_mask(r1)) return i + Lanes + std::countr_zero(mask) / sizeof(T);
+			if (uint32_t mask = byte_mask(r2)) return i + Lanes * 2 + std::countr_zero(mask) / sizeof(T);
+			return i + Lanes * 3 + std::countr_zero(byte_mask(r3)) / sizeof(T);
+		}
+
+		for (; i + Lanes <= count; i += Lanes)
+		{
+			if (uint32_t mask = byte_mask(equal<T>(load(data + i), needle)))
+				return i + std::countr_zero(mask) / sizeof(T);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		if (data[i] == value)
+			return i;
+	}
+	return count;
+}
+
+// Returns the number of elements equal to value
+template<typename T>
+size_t simd_count(const T* data, size_t count, T value)
+{
+	size_t i = 0;
+	size_t matches = 0;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+	if constexpr (is_simd_searchable_v<T>)
+	{
+		using namespace simd_detail;
+		constexpr size_t Lanes = sizeof(Register) / sizeof(T);
+		Register needle = splat(value);
+
+		for (; i + Lanes <= count; i += Lanes)
+			matches += std::popcount(byte_mask(equal<T>(load(data + i), needle)));
+		matches /= sizeof(T);
+	}
+#endif
+
+	for (; i < count; i++)
+		matches += data[i] == value;
+	return matches;
+}